@@ -0,0 +1,66 @@
+/* generated by tools/genparams.awk from src/parameters.spec -- do not edit */
+
+#ifndef REQVAL_PARAMETERS_H
+#define REQVAL_PARAMETERS_H
+
+#include "uris.h"
+
+#define REQVAL__booltest REQVAL_URI "#booltest"
+#define REQVAL__gain REQVAL_URI "#gain"
+#define REQVAL__lookahead REQVAL_URI "#lookahead"
+#define REQVAL__curve REQVAL_URI "#curve"
+#define REQVAL__rules REQVAL_URI "#rules"
+
+enum {
+	REQVAL_P_booltest,
+	REQVAL_P_gain,
+	REQVAL_P_lookahead,
+	REQVAL_P_curve,
+	REQVAL_P_rules,
+	REQVAL_N_PARAMS
+};
+
+/* define REQVAL_NO_PARAM_TABLE for URIs and indices only (e.g. UI) */
+#ifndef REQVAL_NO_PARAM_TABLE
+
+#include <float.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "reqval_client.h"
+
+typedef struct {
+	bool booltest;
+	float gain;
+	bool lookahead;
+} ReqValParamValues;
+
+static const ReqValParamValues reqval_param_defaults = {
+	.booltest = 0,
+	.gain = 0,
+	.lookahead = 0,
+};
+
+
+static const RVC_ParamSpec reqval_params[REQVAL_N_PARAMS] = {
+	{ REQVAL__booltest, RVC_BOOL, -FLT_MAX, FLT_MAX, 0, offsetof (ReqValParamValues, booltest), NULL, 0 },
+	{ REQVAL__gain, RVC_FLOAT, -60, 12, 0, offsetof (ReqValParamValues, gain), NULL, 0 },
+	{ REQVAL__lookahead, RVC_BOOL, -FLT_MAX, FLT_MAX, 0, offsetof (ReqValParamValues, lookahead), NULL, 0 },
+	{ REQVAL__curve, RVC_PATH, -FLT_MAX, FLT_MAX, 0, -1, NULL, 0 },
+	{ REQVAL__rules, RVC_PATH, -FLT_MAX, FLT_MAX, 0, -1, NULL, 0 },
+};
+
+/* answer cache policy, time to live in seconds, 0: not cached */
+#define REQVAL_CACHE_SESSION -1 /* not saved with the session */
+#define REQVAL_CACHE_FOREVER -2
+
+static const int32_t reqval_cache_ttl[REQVAL_N_PARAMS] = {
+	86400, /* booltest */
+	0, /* gain */
+	0, /* lookahead */
+	0, /* curve */
+	0, /* rules */
+};
+
+#endif
+#endif
@@ -0,0 +1,889 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_CAPTURE_H
+#define REQVAL_CAPTURE_H
+
+/* Capture files, the control port input of each run() cycle.
+ *
+ * File layout, integers in host byte order:
+ *
+ *   "RVCAP", version, format, 0, u32 atom:Object, u32 atom:URID
+ *   records, one per cycle, see below
+ *   URI table: varint n, n * (varint length, URI), for URIDs 1..n
+ *   u64 offset of the URI table
+ *
+ * A replay host maps the URIs in order before it instantiates the
+ * plugin, so that the URIDs in the captured atoms remain valid.
+ *
+ * CAP_RAW records are the sequence as is:
+ *
+ *   u64 cycle, u32 n_samples, u32 size, LV2_Atom_Sequence_Body + events
+ *
+ * CAP_COMPACT records delta-encode times and dictionary-encode the
+ * shape of events, which repeats in automation-heavy sessions:
+ *
+ *   varint cycle delta, zigzag n_samples delta, varint n_events
+ *   per event:
+ *     zigzag frame delta to the previous event of the cycle
+ *     varint shape ref, the bytes of the shape's values
+ *
+ * A shape is a padded event body with all headers, property keys and
+ * URID values, but with other values (and the body of non-objects)
+ * cut out: e.g. a patch:Set of the gain parameter to some float. So
+ * decoding an event is a copy of the shape and of its values.
+ *
+ * A ref i < n uses shape i of the dictionary. n defines shape n,
+ * as varint size, varint n_values, n_values * (varint offset, varint
+ * length) and the bytes of the shape, followed by the values.
+ * CAP_DICT_SIZE is an event without a shape, written as varint type,
+ * varint size and the body; used for large events and once the
+ * dictionary is full.
+ *
+ * Cycles without events that have the same n_samples as the previous
+ * one are not written, a cycle delta > 1 implies them.
+ *
+ * Only frame-time sequences of well-formed, zero-padded atoms (as
+ * made by lv2_atom_forge) are supported. Cycles must be written in
+ * order, without gaps. Not realtime safe, the writer is meant to run
+ * in a non-realtime thread.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
+
+#define CAP_VERSION 1
+#define CAP_HEADER_SIZE 16
+#define CAP_BUF_SIZE 65536
+#define CAP_DICT_SIZE 256
+#define CAP_SHAPE_SIZE 256 // max. padded event body with a shape
+#define CAP_SHAPE_VALUES 16
+#define CAP_MAX_VARINT 10
+
+/* encoded size of a record header, and of an event with a known
+ * shape, at most, plus the word its last value is read with. The
+ * reader decodes those from its buffer without further bounds checks
+ * once that many bytes are available */
+#define CAP_HEADER_MAX (3 * CAP_MAX_VARINT)
+#define CAP_EVENT_MAX (2 * CAP_MAX_VARINT + CAP_SHAPE_SIZE + sizeof (uint64_t))
+
+/* space such an event takes in the sequence, at most, and the number
+ * of events decoded between bounds checks. CAP_BATCH * CAP_EVENT_MAX
+ * must fit the reader's buffer */
+#define CAP_EVENT_SPACE (sizeof (int64_t) + CAP_SHAPE_SIZE)
+#define CAP_BATCH 64
+
+typedef enum {
+	CAP_RAW = 0,
+	CAP_COMPACT,
+} CaptureFormat;
+
+typedef struct {
+	uint32_t hash;
+	uint32_t size; // of tmpl, padded
+	uint32_t n_values;
+	uint32_t n_bytes; // of the values
+	uint32_t n_words; // values merged a word at a time, 0: copied
+	uint16_t offset[CAP_SHAPE_VALUES];
+	uint16_t length[CAP_SHAPE_VALUES];
+	uint16_t src[CAP_SHAPE_VALUES];  // of a value in the encoded ones
+	uint64_t mask[CAP_SHAPE_VALUES]; // of a value in its word
+	uint8_t  tmpl[CAP_SHAPE_SIZE];   // zero where the values go
+} CapShape;
+
+/* the writer builds the shape of each event in shape[n] */
+typedef struct {
+	CapShape shape[CAP_DICT_SIZE + 1];
+	uint16_t step[CAP_DICT_SIZE + 1]; // n_bytes of each, for the reader
+	uint32_t n;
+} CapDict;
+
+typedef struct {
+	FILE*         f;
+	CaptureFormat format;
+	LV2_URID      atom_Object;
+	LV2_URID      atom_URID;
+	CapDict       dict;
+	uint64_t      cycle;     // last cycle seen
+	uint64_t      written;   // last cycle written + 1, 0: none
+	uint32_t      n_samples; // of the last cycle written
+	bool          error;
+	uint32_t      n;
+	uint8_t       buf[CAP_BUF_SIZE];
+} CaptureWriter;
+
+typedef struct {
+	FILE*         f;
+	CaptureFormat format;
+	LV2_URID      atom_Object;
+	LV2_URID      atom_URID;
+	CapDict       dict;
+	uint64_t      cycle;        // next cycle
+	uint64_t      written;      // cycle of the last record + 1, 0: none
+	uint64_t      n_events;     // of the pending record
+	bool          pending;      // record header read, events not yet
+	uint32_t      n_samples;    // of the last cycle
+	uint32_t      next_samples; // of the pending record
+	uint64_t      remaining; // record bytes not yet read from the file
+	char**        uris;
+	uint32_t      n_uris;
+	uint32_t      pos;
+	uint32_t      len;
+	uint8_t       buf[CAP_BUF_SIZE];
+} CaptureReader;
+
+/* ****************************************************************************
+ * Writer
+ */
+
+static bool
+cap_flush (CaptureWriter* w)
+{
+	if (w->n > 0 && fwrite (w->buf, 1, w->n, w->f) != w->n) {
+		w->error = true;
+	}
+	w->n = 0;
+	return !w->error;
+}
+
+static void
+cap_put (CaptureWriter* w, const void* data, uint32_t size)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	while (size > 0) {
+		if (w->n == CAP_BUF_SIZE) {
+			cap_flush (w);
+		}
+		uint32_t n = CAP_BUF_SIZE - w->n;
+		if (n > size) {
+			n = size;
+		}
+		memcpy (w->buf + w->n, p, n);
+		w->n += n;
+		p += n;
+		size -= n;
+	}
+}
+
+static inline void
+cap_put_varint (CaptureWriter* w, uint64_t v)
+{
+	if (w->n + CAP_MAX_VARINT > CAP_BUF_SIZE) {
+		cap_flush (w);
+	}
+	while (v >= 0x80) {
+		w->buf[w->n++] = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	w->buf[w->n++] = (uint8_t)v;
+}
+
+static inline void
+cap_put_zigzag (CaptureWriter* w, int64_t v)
+{
+	cap_put_varint (w, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static inline bool
+cap_shape_value (CapShape* s, uint32_t offset, uint32_t length)
+{
+	if (length == 0) {
+		return true;
+	}
+	if (s->n_values == CAP_SHAPE_VALUES) {
+		return false;
+	}
+	s->offset[s->n_values] = offset;
+	s->length[s->n_values] = length;
+	s->n_bytes += length;
+	++s->n_values;
+	memset (s->tmpl + offset, 0, length);
+	return true;
+}
+
+/* the shape of event body `a`, false if it is too large or has too many values */
+static bool
+cap_shape_of (CapShape* s, const LV2_Atom* a, LV2_URID atom_Object, LV2_URID atom_URID)
+{
+	s->size     = lv2_atom_pad_size (sizeof (LV2_Atom) + a->size);
+	s->n_values = 0;
+	s->n_bytes  = 0;
+	if (s->size > CAP_SHAPE_SIZE) {
+		return false;
+	}
+	memcpy (s->tmpl, a, s->size);
+
+	if (a->type != atom_Object) {
+		if (!cap_shape_value (s, sizeof (LV2_Atom), a->size)) {
+			return false;
+		}
+	} else {
+		LV2_ATOM_OBJECT_FOREACH ((const LV2_Atom_Object*)s->tmpl, p)
+		{
+			if (p->value.type == atom_URID && p->value.size == sizeof (LV2_URID)) {
+				continue;
+			}
+			if (!cap_shape_value (s, (const uint8_t*)LV2_ATOM_BODY_CONST (&p->value) - s->tmpl, p->value.size)) {
+				return false;
+			}
+		}
+	}
+
+	uint32_t h = 2166136261U;
+	for (uint32_t i = 0; i < s->size; i += sizeof (uint32_t)) {
+		uint32_t x;
+		memcpy (&x, s->tmpl + i, sizeof (x));
+		h = (h ^ x) * 16777619U;
+	}
+	s->hash = h;
+	return true;
+}
+
+static bool
+cap_writer_open (CaptureWriter* w, const char* path, CaptureFormat format, LV2_URID atom_Object, LV2_URID atom_URID)
+{
+	memset (w, 0, sizeof (CaptureWriter));
+	if (!(w->f = fopen (path, "wb"))) {
+		return false;
+	}
+	w->format      = format;
+	w->atom_Object = atom_Object;
+	w->atom_URID   = atom_URID;
+
+	const uint8_t magic[8] = { 'R', 'V', 'C', 'A', 'P', CAP_VERSION, (uint8_t)format, 0 };
+	cap_put (w, magic, sizeof (magic));
+	cap_put (w, &atom_Object, sizeof (uint32_t));
+	cap_put (w, &atom_URID, sizeof (uint32_t));
+	return true;
+}
+
+static void
+cap_put_header (CaptureWriter* w, uint64_t cycle, uint32_t n_samples, uint32_t n_events)
+{
+	cap_put_varint (w, cycle + 1 - w->written);
+	cap_put_zigzag (w, (int64_t)n_samples - w->n_samples);
+	cap_put_varint (w, n_events);
+	w->written   = cycle + 1;
+	w->n_samples = n_samples;
+}
+
+static void
+cap_encode_event (CaptureWriter* w, const LV2_Atom* a)
+{
+	CapDict* d = &w->dict;
+	CapShape* s = &d->shape[d->n];
+
+	if (!cap_shape_of (s, a, w->atom_Object, w->atom_URID)) {
+		cap_put_varint (w, CAP_DICT_SIZE);
+		cap_put_varint (w, a->type);
+		cap_put_varint (w, a->size);
+		cap_put (w, LV2_ATOM_BODY_CONST (a), a->size);
+		return;
+	}
+
+	uint32_t i;
+	for (i = 0; i < d->n; ++i) {
+		CapShape const* x = &d->shape[i];
+		if (x->hash == s->hash && x->size == s->size && !memcmp (x->tmpl, s->tmpl, s->size)) {
+			s = &d->shape[i];
+			break;
+		}
+	}
+
+	if (i < d->n) {
+		cap_put_varint (w, i);
+	} else if (d->n < CAP_DICT_SIZE) {
+		cap_put_varint (w, d->n++);
+		cap_put_varint (w, s->size);
+		cap_put_varint (w, s->n_values);
+		for (uint32_t k = 0; k < s->n_values; ++k) {
+			cap_put_varint (w, s->offset[k]);
+			cap_put_varint (w, s->length[k]);
+		}
+		cap_put (w, s->tmpl, s->size);
+	} else {
+		cap_put_varint (w, CAP_DICT_SIZE);
+		cap_put_varint (w, a->type);
+		cap_put_varint (w, a->size);
+		cap_put (w, LV2_ATOM_BODY_CONST (a), a->size);
+		return;
+	}
+
+	for (uint32_t k = 0; k < s->n_values; ++k) {
+		cap_put (w, (const uint8_t*)a + s->offset[k], s->length[k]);
+	}
+}
+
+/* append the control input of `cycle`, which must follow the previous one */
+static bool
+cap_write_cycle (CaptureWriter* w, uint64_t cycle, uint32_t n_samples, const LV2_Atom_Sequence* seq)
+{
+	w->cycle = cycle;
+
+	if (w->format == CAP_RAW) {
+		const uint32_t size = seq->atom.size;
+		cap_put (w, &cycle, sizeof (cycle));
+		cap_put (w, &n_samples, sizeof (n_samples));
+		cap_put (w, &size, sizeof (size));
+		cap_put (w, &seq->body, size);
+		return !w->error;
+	}
+
+	uint32_t n_events = 0;
+	LV2_ATOM_SEQUENCE_FOREACH (seq, ev)
+	{
+		++n_events;
+	}
+
+	if (n_events == 0 && n_samples == w->n_samples && w->written > 0) {
+		return !w->error;
+	}
+
+	cap_put_header (w, cycle, n_samples, n_events);
+
+	int64_t frames = 0;
+	LV2_ATOM_SEQUENCE_FOREACH (seq, ev)
+	{
+		cap_put_zigzag (w, ev->time.frames - frames);
+		frames = ev->time.frames;
+		cap_encode_event (w, &ev->body);
+	}
+	return !w->error;
+}
+
+/* write the URI table for URIDs 1..n_uris and close the file */
+static bool
+cap_writer_close (CaptureWriter* w, char* const* uris, uint32_t n_uris)
+{
+	if (w->format == CAP_COMPACT && w->cycle + 1 > w->written && w->written > 0) {
+		/* trailing empty cycles */
+		cap_put_header (w, w->cycle, w->n_samples, 0);
+	}
+
+	cap_flush (w);
+	const uint64_t offset = ftell (w->f);
+
+	cap_put_varint (w, n_uris);
+	for (uint32_t i = 0; i < n_uris; ++i) {
+		const uint32_t len = strlen (uris[i]);
+		cap_put_varint (w, len);
+		cap_put (w, uris[i], len);
+	}
+	cap_put (w, &offset, sizeof (offset));
+
+	const bool ok = cap_flush (w);
+	return fclose (w->f) == 0 && ok;
+}
+
+/* ****************************************************************************
+ * Reader
+ */
+
+static bool
+cap_refill (CaptureReader* r, uint32_t need)
+{
+	memmove (r->buf, r->buf + r->pos, r->len - r->pos);
+	r->len -= r->pos;
+	r->pos = 0;
+
+	uint64_t n = CAP_BUF_SIZE - r->len;
+	if (n > r->remaining) {
+		n = r->remaining;
+	}
+	n = fread (r->buf + r->len, 1, n, r->f);
+	r->len += n;
+	r->remaining -= n;
+	return r->len >= need;
+}
+
+/* make at least `need` bytes available, unless the records end */
+static inline bool
+cap_fill (CaptureReader* r, uint32_t need)
+{
+	return r->len - r->pos >= need || cap_refill (r, need);
+}
+
+static inline bool
+cap_get (CaptureReader* r, void* data, uint32_t size)
+{
+	if (r->len - r->pos >= size) {
+		/* constant sizes are inlined, most values are Int, Float, Long or Double */
+		if (size == 4) {
+			memcpy (data, r->buf + r->pos, 4);
+		} else if (size == 8) {
+			memcpy (data, r->buf + r->pos, 8);
+		} else {
+			memcpy (data, r->buf + r->pos, size);
+		}
+		r->pos += size;
+		return true;
+	}
+
+	uint8_t* p = (uint8_t*)data;
+	while (size > 0) {
+		if (!cap_fill (r, 1)) {
+			return false;
+		}
+		uint32_t n = r->len - r->pos;
+		if (n > size) {
+			n = size;
+		}
+		memcpy (p, r->buf + r->pos, n);
+		r->pos += n;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+static inline bool
+cap_get_varint (CaptureReader* r, uint64_t* v)
+{
+	cap_fill (r, CAP_MAX_VARINT);
+
+	/* most values are small */
+	if (r->pos < r->len && r->buf[r->pos] < 0x80) {
+		*v = r->buf[r->pos++];
+		return true;
+	}
+
+	uint64_t x = 0;
+	for (int shift = 0; shift < 64 && r->pos < r->len; shift += 7) {
+		const uint8_t b = r->buf[r->pos++];
+		x |= (uint64_t)(b & 0x7f) << shift;
+		if (b < 0x80) {
+			*v = x;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* decode a varint at `*p`, at least CAP_MAX_VARINT bytes must be
+ * readable. Returns UINT64_MAX if it is malformed */
+static inline uint64_t
+cap_varint_at (uint8_t const** p)
+{
+	uint8_t const* b = *p;
+	if (b[0] < 0x80) {
+		*p = b + 1;
+		return b[0];
+	}
+	uint64_t x = 0;
+	for (int i = 0; i < CAP_MAX_VARINT; ++i) {
+		x |= (uint64_t)(b[i] & 0x7f) << (7 * i);
+		if (b[i] < 0x80) {
+			*p = b + i + 1;
+			return x;
+		}
+	}
+	*p = b + CAP_MAX_VARINT;
+	return UINT64_MAX;
+}
+
+static inline int64_t
+cap_unzigzag (uint64_t u)
+{
+	return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+static inline bool
+cap_get_zigzag (CaptureReader* r, int64_t* v)
+{
+	uint64_t u;
+	if (!cap_get_varint (r, &u)) {
+		return false;
+	}
+	*v = cap_unzigzag (u);
+	return true;
+}
+
+/* read the definition of a shape. Values must be in order and must
+ * not overlap, so that they are no longer than the shape */
+static bool
+cap_get_shape (CaptureReader* r, CapShape* s)
+{
+	uint64_t end = 0;
+	uint64_t size, n_values;
+	if (!cap_get_varint (r, &size) || !cap_get_varint (r, &n_values) || size < sizeof (LV2_Atom)
+	    || size > CAP_SHAPE_SIZE || (size & 7) || n_values > CAP_SHAPE_VALUES) {
+		return false;
+	}
+	s->size     = size;
+	s->n_values = n_values;
+	s->n_bytes  = 0;
+	s->n_words  = n_values;
+	for (uint32_t k = 0; k < s->n_values; ++k) {
+		uint64_t offset, length;
+		if (!cap_get_varint (r, &offset) || !cap_get_varint (r, &length) || offset < end || offset > size || length > size - offset) {
+			return false;
+		}
+		end          = offset + length;
+		s->offset[k] = offset;
+		s->length[k] = length;
+		s->src[k]    = s->n_bytes;
+		s->n_bytes += length;
+
+		/* values of atoms in an object start at a multiple of 8 */
+		uint8_t mask[sizeof (uint64_t)] = { 0 };
+		if (length == 0 || length > sizeof (uint64_t) || (offset & 7)) {
+			s->n_words = 0;
+		} else {
+			memset (mask, 0xff, length);
+		}
+		memcpy (&s->mask[k], mask, sizeof (uint64_t));
+	}
+	return cap_get (r, s->tmpl, s->size)
+	       && lv2_atom_pad_size (sizeof (LV2_Atom) + ((LV2_Atom const*)s->tmpl)->size) == s->size;
+}
+
+static bool
+cap_reader_open (CaptureReader* r, const char* path)
+{
+	uint8_t  magic[8];
+	uint64_t offset;
+	long     end;
+
+	memset (r, 0, sizeof (CaptureReader));
+	if (!(r->f = fopen (path, "rb"))) {
+		return false;
+	}
+
+	if (fread (magic, 1, sizeof (magic), r->f) != sizeof (magic) || memcmp (magic, "RVCAP", 5) || magic[5] != CAP_VERSION || magic[6] > CAP_COMPACT
+	    || fread (&r->atom_Object, sizeof (uint32_t), 1, r->f) != 1
+	    || fread (&r->atom_URID, sizeof (uint32_t), 1, r->f) != 1
+	    || fseek (r->f, -(long)sizeof (offset), SEEK_END) || (end = ftell (r->f)) < 0
+	    || fread (&offset, sizeof (offset), 1, r->f) != 1 || offset < CAP_HEADER_SIZE || offset > (uint64_t)end
+	    || fseek (r->f, offset, SEEK_SET)) {
+		fclose (r->f);
+		return false;
+	}
+	r->format = (CaptureFormat)magic[6];
+
+	/* URI table */
+	uint64_t n;
+	bool     ok = true;
+	r->remaining = end - offset;
+	if (!cap_get_varint (r, &n) || n > UINT32_MAX || !(r->uris = (char**)calloc (n + 1, sizeof (char*)))) {
+		ok = false;
+	}
+	for (uint32_t i = 0; ok && i < n; ++i) {
+		uint64_t len;
+		if (!cap_get_varint (r, &len) || len > CAP_BUF_SIZE || !(r->uris[i] = (char*)malloc (len + 1))
+		    || !cap_get (r, r->uris[i], len)) {
+			ok = false;
+			break;
+		}
+		r->uris[i][len] = '\0';
+		r->n_uris       = i + 1;
+	}
+
+	/* rewind to the records */
+	r->pos = r->len = 0;
+	r->remaining    = offset - CAP_HEADER_SIZE;
+	if (!ok || fseek (r->f, CAP_HEADER_SIZE, SEEK_SET)) {
+		for (uint32_t i = 0; r->uris && i < r->n_uris; ++i) {
+			free (r->uris[i]);
+		}
+		free (r->uris);
+		fclose (r->f);
+		return false;
+	}
+	return true;
+}
+
+static void
+cap_reader_close (CaptureReader* r)
+{
+	for (uint32_t i = 0; i < r->n_uris; ++i) {
+		free (r->uris[i]);
+	}
+	free (r->uris);
+	fclose (r->f);
+}
+
+/* reserve `size` bytes at the end of the sequence, NULL if it does not fit */
+static inline uint8_t*
+cap_seq_append (LV2_Atom_Sequence* seq, uint32_t capacity, uint32_t size)
+{
+	const uint32_t at = sizeof (LV2_Atom) + seq->atom.size;
+	if (size > capacity || at > capacity - size) {
+		return NULL;
+	}
+	seq->atom.size += size;
+	return (uint8_t*)seq + at;
+}
+
+/* zero the padding after `size` bytes at `p`, before the data is written */
+static inline void
+cap_zero_pad (uint8_t* p, uint32_t size)
+{
+	if (size & 7) {
+		memset (p + (size & ~7U), 0, 8);
+	}
+}
+
+/* an event without a known shape, or close to the end of the records */
+static bool
+cap_decode_event_slow (CaptureReader* r, LV2_Atom_Sequence* seq, uint32_t capacity, int64_t frames)
+{
+	uint64_t        i;
+	LV2_Atom_Event* ev;
+
+	if (!cap_get_varint (r, &i)) {
+		return false;
+	}
+
+	if (i == CAP_DICT_SIZE) {
+		uint64_t type, size;
+		if (!cap_get_varint (r, &type) || !cap_get_varint (r, &size) || type > UINT32_MAX || size > capacity
+		    || !(ev = (LV2_Atom_Event*)cap_seq_append (seq, capacity, lv2_atom_pad_size (sizeof (LV2_Atom_Event) + size)))) {
+			return false;
+		}
+		ev->time.frames = frames;
+		ev->body.type   = type;
+		ev->body.size   = size;
+		cap_zero_pad ((uint8_t*)(ev + 1), size);
+		return cap_get (r, ev + 1, size);
+	}
+
+	if (i == r->dict.n) {
+		if (!cap_get_shape (r, &r->dict.shape[i])) {
+			return false;
+		}
+		r->dict.step[r->dict.n++] = r->dict.shape[i].n_bytes;
+	} else if (i > r->dict.n) {
+		return false;
+	}
+
+	CapShape const* s = &r->dict.shape[i];
+	if (!(ev = (LV2_Atom_Event*)cap_seq_append (seq, capacity, sizeof (ev->time) + s->size))) {
+		return false;
+	}
+	ev->time.frames = frames;
+	memcpy (&ev->body, s->tmpl, s->size);
+
+	uint8_t* const body = (uint8_t*)&ev->body;
+	for (uint32_t k = 0; k < s->n_values; ++k) {
+		if (!cap_get (r, body + s->offset[k], s->length[k])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* value `j` of an event with shape `s`, at `v`, into the word of `body`
+ * that holds it. Reads up to 7 bytes past the value */
+static inline void
+cap_merge_value (uint8_t* body, CapShape const* s, uint32_t j, uint8_t const* v)
+{
+	uint64_t x, t;
+	memcpy (&x, v + s->src[j], sizeof (uint64_t));
+	memcpy (&t, s->tmpl + s->offset[j], sizeof (uint64_t));
+	x = (x & s->mask[j]) | t;
+	memcpy (body + s->offset[j], &x, sizeof (uint64_t));
+}
+
+/* decode the `n_events` events of a record into `seq`. Events with a
+ * known shape are a copy of the template and the values. As many as
+ * surely fit, in the buffer and in the sequence, are decoded without
+ * further bounds checks, and with the state in locals rather than in
+ * `r` and `seq`, which the stores to the event bodies may alias */
+static bool
+cap_decode_events (CaptureReader* r, LV2_Atom_Sequence* seq, uint32_t capacity, uint64_t n_events)
+{
+	uint8_t* const  out    = (uint8_t*)seq;
+	CapShape const* shapes = r->dict.shape;
+	uint16_t const* steps  = r->dict.step;
+	int64_t         frames = 0;
+
+	while (n_events > 0) {
+		const uint32_t room = capacity - sizeof (LV2_Atom) - seq->atom.size;
+
+		uint64_t n = n_events < CAP_BATCH ? n_events : CAP_BATCH;
+		if (!cap_fill (r, n * CAP_EVENT_MAX) || n * CAP_EVENT_SPACE > room) {
+			if (n > (r->len - r->pos) / CAP_EVENT_MAX) {
+				n = (r->len - r->pos) / CAP_EVENT_MAX;
+			}
+			if (n > room / CAP_EVENT_SPACE) {
+				n = room / CAP_EVENT_SPACE;
+			}
+		}
+
+		uint8_t const* p        = r->buf + r->pos;
+		uint8_t*       dst      = out + sizeof (LV2_Atom) + seq->atom.size;
+		const uint32_t n_shapes = r->dict.n;
+
+		if (n == 0) {
+			/* close to the end of the records, or of the sequence */
+			int64_t dt;
+			if (!cap_get_zigzag (r, &dt) || !cap_decode_event_slow (r, seq, capacity, frames += dt)) {
+				return false;
+			}
+			--n_events;
+			continue;
+		}
+
+		uint64_t k;
+		for (k = 0; k < n; ++k) {
+			const uint64_t dt = cap_varint_at (&p);
+			if (dt == UINT64_MAX) {
+				return false;
+			}
+			frames += cap_unzigzag (dt);
+
+			uint8_t const* const ref = p;
+			const uint64_t       i   = cap_varint_at (&p);
+			if (i >= n_shapes) {
+				p = ref;
+				break;
+			}
+
+			CapShape const* sh   = &shapes[i];
+			uint8_t* const  body = dst + sizeof (int64_t);
+			memcpy (dst, &frames, sizeof (int64_t));
+			if (sh->size <= 64) {
+				/* a constant size is inlined. It may copy past the
+				 * event, into space the next one overwrites */
+				memcpy (body, sh->tmpl, 64);
+			} else if (sh->size <= 128) {
+				memcpy (body, sh->tmpl, 128);
+			} else {
+				memcpy (body, sh->tmpl, sh->size);
+			}
+
+			/* the next event depends on neither the copies nor the
+			 * shape, only on a load from the short table of steps */
+			uint8_t const* v = p;
+			p += steps[i];
+			switch (sh->n_words) {
+				/* merge each value into the word of the template that
+				 * holds it, without a branch on its size. Most events
+				 * are a patch:Set with one value, or a time:Position */
+				case 4:
+					cap_merge_value (body, sh, 3, v);
+					/* fall through */
+				case 3:
+					cap_merge_value (body, sh, 2, v);
+					/* fall through */
+				case 2:
+					cap_merge_value (body, sh, 1, v);
+					/* fall through */
+				case 1:
+					cap_merge_value (body, sh, 0, v);
+					break;
+				default:
+					for (uint32_t j = 0; j < sh->n_values; ++j) {
+						memcpy (body + sh->offset[j], v, sh->length[j]);
+						v += sh->length[j];
+					}
+					break;
+			}
+			dst = body + sh->size;
+		}
+
+		r->pos         = p - r->buf;
+		seq->atom.size = dst - out - sizeof (LV2_Atom);
+		n_events -= k;
+
+		if (k < n) {
+			/* a new shape, or an event without one */
+			if (!cap_decode_event_slow (r, seq, capacity, frames)) {
+				return false;
+			}
+			--n_events;
+		}
+	}
+	return true;
+}
+
+/* read the next cycle into `seq`, which can hold `capacity` bytes
+ * including the atom header. Returns 1, 0 at the end, or -1 on error */
+static int
+cap_read_cycle (CaptureReader* r, uint64_t* cycle, uint32_t* n_samples, LV2_Atom_Sequence* seq, uint32_t capacity)
+{
+	if (capacity < sizeof (LV2_Atom_Sequence)) {
+		return -1;
+	}
+
+	seq->atom.type = 0;
+	seq->atom.size = sizeof (LV2_Atom_Sequence_Body);
+	seq->body.unit = 0;
+	seq->body.pad  = 0;
+
+	if (r->format == CAP_RAW) {
+		uint32_t size;
+		if (!cap_fill (r, 1)) {
+			return 0;
+		}
+		if (!cap_get (r, cycle, sizeof (uint64_t)) || !cap_get (r, n_samples, sizeof (uint32_t))
+		    || !cap_get (r, &size, sizeof (uint32_t)) || size > capacity - sizeof (LV2_Atom)
+		    || !cap_get (r, &seq->body, size)) {
+			return -1;
+		}
+		seq->atom.size = size;
+		return 1;
+	}
+
+	if (!r->pending) {
+		uint64_t delta;
+		int64_t  dn;
+		if (!cap_fill (r, 1)) {
+			return 0;
+		}
+		if (cap_fill (r, CAP_HEADER_MAX)) {
+			uint8_t const* p = r->buf + r->pos;
+			delta            = cap_varint_at (&p);
+			dn               = cap_unzigzag (cap_varint_at (&p));
+			r->n_events      = cap_varint_at (&p);
+			r->pos           = p - r->buf;
+		} else if (!cap_get_varint (r, &delta) || !cap_get_zigzag (r, &dn) || !cap_get_varint (r, &r->n_events)) {
+			return -1;
+		}
+		if (delta == 0 || delta == UINT64_MAX || r->n_events == UINT64_MAX
+		    || (int64_t)r->n_samples + dn < 0 || (int64_t)r->n_samples + dn > UINT32_MAX) {
+			return -1;
+		}
+		if (r->written == 0) {
+			r->cycle = delta - 1;
+		}
+		r->written += delta;
+		r->next_samples = r->n_samples + dn;
+		r->pending      = true;
+	}
+
+	/* implied empty cycles come first, with the previous size */
+	if (r->cycle + 1 < r->written) {
+		*cycle     = r->cycle++;
+		*n_samples = r->n_samples;
+		return 1;
+	}
+
+	r->pending   = false;
+	r->n_samples = r->next_samples;
+	*cycle       = r->cycle++;
+	*n_samples   = r->n_samples;
+
+	return cap_decode_events (r, seq, capacity, r->n_events) ? 1 : -1;
+}
+
+#endif
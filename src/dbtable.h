@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_DBTABLE_H
+#define REQVAL_DBTABLE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/* dB <> linear gain conversion, interpolated lookup tables.
+ *
+ * dB to gain: DBTABLE_RES steps per dB from DBTABLE_MIN to DBTABLE_MAX,
+ * max. relative error ~2e-5. Values outside the range use powf ().
+ *
+ * gain to dB: the float's exponent gives the octave, its top mantissa
+ * bits index a table of 20 * log10 (m), 1 <= m < 2. Max. absolute
+ * error ~2e-5 dB. Gains <= 0 are -inf dB, denormals, inf and NaN
+ * use log10f ().
+ *
+ * The tables are filled by dbt_init (), conversion is realtime safe.
+ * See tools/db_bench.c for accuracy and throughput.
+ */
+
+#define DBTABLE_MIN (-100)
+#define DBTABLE_MAX 24
+#define DBTABLE_RES 10
+#define DBTABLE_SIZE ((DBTABLE_MAX - DBTABLE_MIN) * DBTABLE_RES + 1)
+#define DBTABLE_LOG_BITS 8
+
+/* 20 * log10 (2) */
+#define DBTABLE_DB_PER_OCTAVE 6.0205999132796239
+
+typedef struct {
+	float gain[DBTABLE_SIZE + 1];           // one extra for interpolation
+	float db[(1 << DBTABLE_LOG_BITS) + 1]; // 20 * log10 (1 + i / 2^bits)
+} DbTable;
+
+static inline void
+dbt_init (DbTable* t)
+{
+	for (int i = 0; i <= DBTABLE_SIZE; ++i) {
+		t->gain[i] = pow (10.0, .05 * (DBTABLE_MIN + i / (double)DBTABLE_RES));
+	}
+	for (int i = 0; i <= (1 << DBTABLE_LOG_BITS); ++i) {
+		t->db[i] = 20.0 * log10 (1.0 + i / (double)(1 << DBTABLE_LOG_BITS));
+	}
+}
+
+static inline float
+dbt_to_gain (DbTable const* t, float db)
+{
+	if (!(db >= DBTABLE_MIN && db <= DBTABLE_MAX)) {
+		return powf (10.f, .05f * db);
+	}
+	const float pos = (db - DBTABLE_MIN) * DBTABLE_RES;
+	const int   i   = (int)pos;
+	const float f   = pos - i;
+	return t->gain[i] + f * (t->gain[i + 1] - t->gain[i]);
+}
+
+static inline float
+dbt_to_db (DbTable const* t, float gain)
+{
+	if (gain <= 0) {
+		return -INFINITY;
+	}
+
+	uint32_t bits;
+	memcpy (&bits, &gain, sizeof (bits));
+
+	const int exp = (int)((bits >> 23) & 0xff);
+	if (exp == 0 || exp == 0xff) {
+		return 20.f * log10f (gain);
+	}
+
+	const int      shift = 23 - DBTABLE_LOG_BITS;
+	const uint32_t i     = (bits >> shift) & ((1 << DBTABLE_LOG_BITS) - 1);
+	const float    f     = (bits & ((1 << shift) - 1)) / (float)(1 << shift);
+	return (float)((exp - 127) * DBTABLE_DB_PER_OCTAVE) + t->db[i] + f * (t->db[i + 1] - t->db[i]);
+}
+
+#endif
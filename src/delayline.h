@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_DELAYLINE_H
+#define REQVAL_DELAYLINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Fixed length circular delay line.
+ *
+ * The buffer is allocated once, processing splits each block
+ * into at most two contiguous segments at the wrap point so that
+ * the inner loops have no index masking and vectorize.
+ * Input and output buffers may be identical (in-place).
+ */
+
+typedef struct {
+	float*   buf;
+	uint32_t len;
+	uint32_t pos;
+} DelayLine;
+
+static inline bool
+delayline_init (DelayLine* dl, uint32_t len)
+{
+	dl->pos = 0;
+	dl->len = len;
+	dl->buf = len > 0 ? (float*)calloc (len, sizeof (float)) : NULL;
+	return len == 0 || dl->buf != NULL;
+}
+
+static inline void
+delayline_free (DelayLine* dl)
+{
+	free (dl->buf);
+	dl->buf = NULL;
+	dl->len = 0;
+}
+
+static inline void
+delayline_reset (DelayLine* dl)
+{
+	if (dl->len > 0) {
+		memset (dl->buf, 0, sizeof (float) * dl->len);
+	}
+	dl->pos = 0;
+}
+
+static inline void
+delayline_segment (float* buf, float const* in, float* out, uint32_t n)
+{
+	for (uint32_t i = 0; i < n; ++i) {
+		const float x = in[i];
+		out[i]        = buf[i];
+		buf[i]        = x;
+	}
+}
+
+static inline void
+delayline_process (DelayLine* dl, float const* in, float* out, uint32_t n_samples)
+{
+	if (dl->len == 0) {
+		if (in != out) {
+			memcpy (out, in, sizeof (float) * n_samples);
+		}
+		return;
+	}
+
+	while (n_samples > 0) {
+		uint32_t n = dl->len - dl->pos;
+		if (n > n_samples) {
+			n = n_samples;
+		}
+		delayline_segment (&dl->buf[dl->pos], in, out, n);
+		dl->pos += n;
+		if (dl->pos == dl->len) {
+			dl->pos = 0;
+		}
+		in += n;
+		out += n;
+		n_samples -= n;
+	}
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_EVMERGE_H
+#define REQVAL_EVMERGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* K-way merge of time-ordered event sources.
+ *
+ * Each source yields its events in non-decreasing time order.
+ * The current head of every source is kept in a binary min-heap,
+ * ordered by time, and by source index for events at the same time
+ * (sources added first win). Popping is O(log K), K <= EVM_MAX_SOURCES.
+ *
+ * The event returned by evm_pop () remains valid until the next
+ * call to evm_pop (): a source is only advanced lazily, so it can
+ * hand out pointers to its own storage.
+ */
+
+#define EVM_MAX_SOURCES 8
+
+typedef struct {
+	int64_t     time;   // sample offset, relative to the cycle start
+	uint32_t    source; // index of the source, set by evm_add ()
+	const void* data;
+} EvMergeEvent;
+
+/* fill `ev` with the next event of the source and advance, return false at the end */
+typedef bool (*EvMergeNext) (void* src, EvMergeEvent* ev);
+
+typedef struct {
+	EvMergeNext next[EVM_MAX_SOURCES];
+	void*       src[EVM_MAX_SOURCES];
+	uint32_t    n_src;
+
+	EvMergeEvent heap[EVM_MAX_SOURCES];
+	uint32_t     n_heap;
+	int32_t      refill; // source to advance on the next pop, -1: none
+} EvMerge;
+
+static inline bool
+evm_less (EvMergeEvent const* a, EvMergeEvent const* b)
+{
+	return a->time < b->time || (a->time == b->time && a->source < b->source);
+}
+
+static inline void
+evm_sift_up (EvMerge* m, uint32_t i)
+{
+	while (i > 0) {
+		const uint32_t p = (i - 1) / 2;
+		if (!evm_less (&m->heap[i], &m->heap[p])) {
+			break;
+		}
+		const EvMergeEvent t = m->heap[i];
+		m->heap[i]           = m->heap[p];
+		m->heap[p]           = t;
+		i                    = p;
+	}
+}
+
+static inline void
+evm_sift_down (EvMerge* m, uint32_t i)
+{
+	while (true) {
+		const uint32_t l = 2 * i + 1;
+		const uint32_t r = l + 1;
+		uint32_t       s = i;
+		if (l < m->n_heap && evm_less (&m->heap[l], &m->heap[s])) {
+			s = l;
+		}
+		if (r < m->n_heap && evm_less (&m->heap[r], &m->heap[s])) {
+			s = r;
+		}
+		if (s == i) {
+			break;
+		}
+		const EvMergeEvent t = m->heap[i];
+		m->heap[i]           = m->heap[s];
+		m->heap[s]           = t;
+		i                    = s;
+	}
+}
+
+static inline void
+evm_init (EvMerge* m)
+{
+	m->n_src  = 0;
+	m->n_heap = 0;
+	m->refill = -1;
+}
+
+static inline bool
+evm_add (EvMerge* m, EvMergeNext next, void* src)
+{
+	if (m->n_src >= EVM_MAX_SOURCES) {
+		return false;
+	}
+	const uint32_t s = m->n_src++;
+	m->next[s]       = next;
+	m->src[s]        = src;
+
+	EvMergeEvent* ev = &m->heap[m->n_heap];
+	if (next (src, ev)) {
+		ev->source = s;
+		evm_sift_up (m, m->n_heap++);
+	}
+	return true;
+}
+
+/* return the earliest pending event of all sources, false when all are exhausted */
+static inline bool
+evm_pop (EvMerge* m, EvMergeEvent* ev)
+{
+	if (m->refill >= 0) {
+		/* the previous event was at the top, replace it with its successor */
+		const uint32_t s = m->refill;
+		m->refill        = -1;
+		if (m->next[s] (m->src[s], &m->heap[0])) {
+			m->heap[0].source = s;
+		} else {
+			m->heap[0] = m->heap[--m->n_heap];
+		}
+		evm_sift_down (m, 0);
+	}
+
+	if (m->n_heap == 0) {
+		return false;
+	}
+
+	*ev       = m->heap[0];
+	m->refill = ev->source;
+	return true;
+}
+
+#endif
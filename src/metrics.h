@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_METRICS_H
+#define REQVAL_METRICS_H
+
+/* Optional per-instance metrics exporter.
+ *
+ * If $REQVAL_METRICS_DIR is set, the plugin starts a non-realtime
+ * thread that writes the instance's counters every METRICS_INTERVAL_MS
+ * to $REQVAL_METRICS_DIR/reqval-<pid>-<id>.prom in Prometheus text
+ * exposition format, e.g. for node_exporter's textfile collector.
+ * The file is written under a temporary name and renamed, readers
+ * never see a partial file. It is removed when the instance is
+ * deleted.
+ *
+ * run() publishes a Metrics snapshot with a seqlock, the thread only
+ * reads that copy and never blocks run().
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "seqlock.h"
+
+#define METRICS_INTERVAL_MS 1000
+#define METRICS_POLL_NS 100000000 // shutdown latency
+#define METRICS_N_BUCKETS 8
+
+/* upper bounds of the histogram buckets, seconds */
+static const double metrics_latency_le[METRICS_N_BUCKETS] = { .1, .25, .5, 1, 2.5, 5, 10, 30 };
+static const double metrics_run_le[METRICS_N_BUCKETS]     = { 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 5e-3 };
+
+typedef struct {
+	uint64_t count;
+	double   sum;
+	uint64_t bucket[METRICS_N_BUCKETS]; // not cumulative, values above the last bound are only counted
+} MetricsHistogram;
+
+typedef struct {
+	uint64_t n_host_events;     // control port
+	uint64_t n_internal_events; // timed events
+	uint64_t n_requests;        // issued to the host, all parameters
+	uint64_t n_host_rejected;   // requests refused by the host
+	uint32_t n_answers;
+	uint32_t n_cached;
+	uint32_t n_clamped;
+	uint32_t n_rejected; // malformed or out-of-range values
+	uint32_t n_overruns;
+	uint32_t load_level;
+
+	MetricsHistogram latency;  // request to answer
+	MetricsHistogram run_cost; // run() wall time
+} Metrics;
+
+typedef struct {
+	Metrics const* pub;
+	SeqLock const* lock;
+	pthread_t      thread;
+	bool           running;
+	char           path[1024];
+	char           tmp[1024];
+	char           instance[32]; // label value
+} MetricsExporter;
+
+/* realtime-safe */
+static inline void
+metrics_observe (MetricsHistogram* h, double const* le, double v)
+{
+	++h->count;
+	h->sum += v;
+	for (uint32_t i = 0; i < METRICS_N_BUCKETS; ++i) {
+		if (v <= le[i]) {
+			++h->bucket[i];
+			break;
+		}
+	}
+}
+
+static void
+metrics_write_counter (FILE* f, MetricsExporter const* e, const char* name, const char* help, const char* label, uint64_t v)
+{
+	fprintf (f, "# HELP reqval_%s %s\n# TYPE reqval_%s counter\n", name, help, name);
+	fprintf (f, "reqval_%s{plugin_instance=\"%s\"%s} %llu\n", name, e->instance, label, (unsigned long long)v);
+}
+
+static void
+metrics_write_histogram (FILE* f, MetricsExporter const* e, const char* name, const char* help,
+                         MetricsHistogram const* h, double const* le)
+{
+	uint64_t n = 0;
+	fprintf (f, "# HELP reqval_%s %s\n# TYPE reqval_%s histogram\n", name, help, name);
+	for (uint32_t i = 0; i < METRICS_N_BUCKETS; ++i) {
+		n += h->bucket[i];
+		fprintf (f, "reqval_%s_bucket{plugin_instance=\"%s\",le=\"%g\"} %llu\n", name, e->instance, le[i], (unsigned long long)n);
+	}
+	fprintf (f, "reqval_%s_bucket{plugin_instance=\"%s\",le=\"+Inf\"} %llu\n", name, e->instance, (unsigned long long)h->count);
+	fprintf (f, "reqval_%s_sum{plugin_instance=\"%s\"} %.9g\n", name, e->instance, h->sum);
+	fprintf (f, "reqval_%s_count{plugin_instance=\"%s\"} %llu\n", name, e->instance, (unsigned long long)h->count);
+}
+
+static bool
+metrics_write (MetricsExporter const* e)
+{
+	Metrics m;
+	seqlock_read (e->lock, &m, e->pub, sizeof (Metrics));
+
+	FILE* f = fopen (e->tmp, "w");
+	if (!f) {
+		return false;
+	}
+
+	metrics_write_counter (f, e, "events_total", "Events dispatched by run().", ",source=\"host\"", m.n_host_events);
+	fprintf (f, "reqval_events_total{plugin_instance=\"%s\",source=\"internal\"} %llu\n", e->instance, (unsigned long long)m.n_internal_events);
+
+	metrics_write_counter (f, e, "errors_total", "Rejected parameter values and requests.", ",kind=\"value\"", m.n_rejected);
+	fprintf (f, "reqval_errors_total{plugin_instance=\"%s\",kind=\"request\"} %llu\n", e->instance, (unsigned long long)m.n_host_rejected);
+
+	metrics_write_counter (f, e, "requests_total", "Requests issued to the host.", "", m.n_requests);
+	metrics_write_counter (f, e, "answers_total", "Answers received.", "", m.n_answers);
+	metrics_write_counter (f, e, "cached_total", "Requests answered from the cache.", "", m.n_cached);
+	metrics_write_counter (f, e, "clamped_total", "Parameter values limited to their range.", "", m.n_clamped);
+	metrics_write_counter (f, e, "overruns_total", "run() cycles that exceeded the budget.", "", m.n_overruns);
+
+	fprintf (f, "# HELP reqval_load_level Watchdog degradation level.\n# TYPE reqval_load_level gauge\n");
+	fprintf (f, "reqval_load_level{plugin_instance=\"%s\"} %u\n", e->instance, m.load_level);
+
+	metrics_write_histogram (f, e, "answer_latency_seconds", "Time from a request to its answer.", &m.latency, metrics_latency_le);
+	metrics_write_histogram (f, e, "run_seconds", "Wall time of run().", &m.run_cost, metrics_run_le);
+
+	if (fclose (f) != 0) {
+		unlink (e->tmp);
+		return false;
+	}
+	return rename (e->tmp, e->path) == 0;
+}
+
+static void*
+metrics_thread (void* arg)
+{
+	MetricsExporter* e     = (MetricsExporter*)arg;
+	struct timespec  ts    = { 0, METRICS_POLL_NS };
+	const uint32_t   ticks = METRICS_INTERVAL_MS * 1000000LL / METRICS_POLL_NS;
+	uint32_t         n     = 0;
+
+	while (__atomic_load_n (&e->running, __ATOMIC_ACQUIRE)) {
+		nanosleep (&ts, NULL);
+		if (++n >= ticks) {
+			n = 0;
+			metrics_write (e);
+		}
+	}
+	return NULL;
+}
+
+/* write to `dir`, returns false if the directory is not writable
+ * or the thread cannot be started */
+static inline bool
+metrics_start (MetricsExporter* e, const char* dir, Metrics const* pub, SeqLock const* lock)
+{
+	static uint32_t instance_cnt = 0;
+
+	const uint32_t id = __atomic_add_fetch (&instance_cnt, 1, __ATOMIC_RELAXED);
+	snprintf (e->instance, sizeof (e->instance), "%d-%u", (int)getpid (), id);
+	snprintf (e->path, sizeof (e->path), "%s/reqval-%s.prom", dir, e->instance);
+	snprintf (e->tmp, sizeof (e->tmp), "%s/.reqval-%s.prom.tmp", dir, e->instance);
+
+	e->pub  = pub;
+	e->lock = lock;
+
+	/* fail early if the directory is not writable */
+	if (!metrics_write (e)) {
+		return false;
+	}
+
+	e->running = true;
+	if (pthread_create (&e->thread, NULL, metrics_thread, e)) {
+		e->running = false;
+		unlink (e->path);
+		return false;
+	}
+	return true;
+}
+
+static inline void
+metrics_stop (MetricsExporter* e)
+{
+	if (!e->running) {
+		return;
+	}
+	__atomic_store_n (&e->running, false, __ATOMIC_RELEASE);
+	pthread_join (e->thread, NULL);
+	unlink (e->path);
+}
+
+#endif
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_MSGTEMPLATE_H
+#define REQVAL_MSGTEMPLATE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "reqval_client.h"
+
+/* Dialog message templates
+ *
+ *   "Gain is {gain:1} dB at bar {bar}, {requests} requests so far"
+ *
+ * A placeholder is a parameter symbol or one of
+ *
+ *   level     measured peak level, dBFS
+ *   bar       transport bar, as sent by the host
+ *   beat      beat in the bar
+ *   requests  number of requests issued
+ *
+ * optionally followed by `:N`, the number of decimals (0..6) of
+ * floating point values, default 2. "{{" is a literal '{'.
+ * Path parameters are not supported.
+ *
+ * mt_compile() parses the template once into an op list, it is
+ * not realtime safe. mt_render() is: it formats values without
+ * libc, and output is truncated to MT_MSG_LEN - 1 bytes.
+ *
+ * Messages are rendered into the buffer of a queued request,
+ * see rvc_enqueue_msg().
+ */
+
+#define MT_MAX_OPS 16
+#define MT_TEXT_LEN 128
+#define MT_MSG_LEN RVC_MSG_LEN
+
+#define MT_MAX_PREC 6
+#define MT_DEFAULT_PREC 2
+
+typedef enum {
+	MT_TEXT = 0, // arg: offset in text
+	MT_BOOL,     // arg: byte offset in value storage
+	MT_INT,
+	MT_FLOAT,
+	MT_LEVEL,
+	MT_BAR,
+	MT_BEAT,
+	MT_REQUESTS,
+} MsgOpKind;
+
+typedef struct {
+	uint8_t  kind; // MsgOpKind
+	uint8_t  prec; // decimals
+	uint16_t len;  // MT_TEXT only
+	int32_t  arg;
+} MsgOp;
+
+typedef struct {
+	MsgOp    op[MT_MAX_OPS];
+	uint32_t n_ops;
+	bool     uses_level;        // the input level has to be measured
+	char     text[MT_TEXT_LEN]; // literal parts
+} MsgTemplate;
+
+/* live state, read by mt_render () */
+typedef struct {
+	void const* values; // parameter storage, see RVC_ParamSpec::offset
+	float       level;  // dBFS
+	int64_t     bar;
+	float       beat;
+	uint32_t    requests;
+} MsgInput;
+
+/* ****************************************************************************
+ * Compiler, not realtime safe
+ */
+
+static bool
+mt_add_op (MsgTemplate* t, MsgOpKind kind, int32_t arg, uint32_t len, uint32_t prec)
+{
+	if (t->n_ops >= MT_MAX_OPS) {
+		return false;
+	}
+	MsgOp* op = &t->op[t->n_ops++];
+	op->kind  = kind;
+	op->arg   = arg;
+	op->len   = len;
+	op->prec  = prec;
+	return true;
+}
+
+/* parse the placeholder "name[:N]" of length `len` */
+static bool
+mt_compile_placeholder (MsgTemplate* t, const char* s, size_t len, RVC_ParamSpec const* params, uint32_t n_params)
+{
+	char     name[64];
+	uint32_t prec = MT_DEFAULT_PREC;
+
+	const char* colon = memchr (s, ':', len);
+	if (colon) {
+		if (colon + 2 != s + len || colon[1] < '0' || colon[1] > '0' + MT_MAX_PREC) {
+			return false;
+		}
+		prec = colon[1] - '0';
+		len  = colon - s;
+	}
+	if (len == 0 || len >= sizeof (name)) {
+		return false;
+	}
+	memcpy (name, s, len);
+	name[len] = '\0';
+
+	if (!strcmp (name, "level")) {
+		t->uses_level = true;
+		return mt_add_op (t, MT_LEVEL, 0, 0, prec);
+	} else if (!strcmp (name, "bar")) {
+		return mt_add_op (t, MT_BAR, 0, 0, 0);
+	} else if (!strcmp (name, "beat")) {
+		return mt_add_op (t, MT_BEAT, 0, 0, prec);
+	} else if (!strcmp (name, "requests")) {
+		return mt_add_op (t, MT_REQUESTS, 0, 0, 0);
+	}
+
+	const int p = rvc_find_symbol (params, n_params, name);
+	if (p < 0 || params[p].offset < 0) {
+		return false;
+	}
+	switch (params[p].kind) {
+		case RVC_BOOL:
+			return mt_add_op (t, MT_BOOL, params[p].offset, 0, 0);
+		case RVC_INT:
+			return mt_add_op (t, MT_INT, params[p].offset, 0, 0);
+		case RVC_FLOAT:
+			return mt_add_op (t, MT_FLOAT, params[p].offset, 0, prec);
+		default:
+			return false;
+	}
+}
+
+/* compile `src`, returns false on syntax error, unknown placeholders
+ * or if the template exceeds MT_MAX_OPS or MT_TEXT_LEN */
+static bool
+mt_compile (MsgTemplate* t, const char* src, RVC_ParamSpec const* params, uint32_t n_params)
+{
+	const char* s = src;
+	uint32_t    n = 0;
+
+	memset (t, 0, sizeof (MsgTemplate));
+
+	while (*s) {
+		/* literal text up to the next placeholder */
+		const uint32_t start = n;
+		while (*s && !(s[0] == '{' && s[1] != '{')) {
+			if (s[0] == '{') {
+				++s;
+			}
+			if (n >= MT_TEXT_LEN) {
+				return false;
+			}
+			t->text[n++] = *s++;
+		}
+		if (n > start && !mt_add_op (t, MT_TEXT, start, n - start, 0)) {
+			return false;
+		}
+		if (!*s) {
+			break;
+		}
+
+		const char* end = strchr (s, '}');
+		if (!end || !mt_compile_placeholder (t, s + 1, end - s - 1, params, n_params)) {
+			return false;
+		}
+		s = end + 1;
+	}
+	return true;
+}
+
+/* ****************************************************************************
+ * Rendering, realtime safe
+ */
+
+typedef struct {
+	char*    buf;
+	uint32_t n;
+} MsgOut;
+
+static inline void
+mt_put (MsgOut* o, const char* s, uint32_t len)
+{
+	if (len > MT_MSG_LEN - 1 - o->n) {
+		len = MT_MSG_LEN - 1 - o->n;
+	}
+	memcpy (o->buf + o->n, s, len);
+	o->n += len;
+}
+
+static inline void
+mt_put_uint (MsgOut* o, uint64_t v, uint32_t min_digits)
+{
+	char     tmp[24];
+	uint32_t i = sizeof (tmp);
+	do {
+		tmp[--i] = '0' + v % 10;
+		v /= 10;
+	} while (v > 0 || sizeof (tmp) - i < min_digits);
+	mt_put (o, tmp + i, sizeof (tmp) - i);
+}
+
+static inline void
+mt_put_int (MsgOut* o, int64_t v)
+{
+	if (v < 0) {
+		mt_put (o, "-", 1);
+		mt_put_uint (o, -(uint64_t)v, 1);
+	} else {
+		mt_put_uint (o, v, 1);
+	}
+}
+
+static inline void
+mt_put_float (MsgOut* o, float v, uint32_t prec)
+{
+	static const double scale[MT_MAX_PREC + 1] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6 };
+
+	if (isnan (v)) {
+		mt_put (o, "nan", 3);
+		return;
+	}
+	if (v < 0) {
+		mt_put (o, "-", 1);
+		v = -v;
+	}
+	/* beyond 2^53 / 1e6 integer and fraction do not fit */
+	if (v > 1e9f) {
+		mt_put (o, "inf", 3);
+		return;
+	}
+	const uint64_t r = (uint64_t)(v * scale[prec] + .5);
+	const uint64_t d = (uint64_t)scale[prec];
+	mt_put_uint (o, r / d, 1);
+	if (prec > 0) {
+		mt_put (o, ".", 1);
+		mt_put_uint (o, r % d, prec);
+	}
+}
+
+/* render into `buf`, which must hold MT_MSG_LEN bytes */
+static inline char const*
+mt_render (MsgTemplate const* t, MsgInput const* in, char* buf)
+{
+	MsgOut o = { buf, 0 };
+
+	for (uint32_t i = 0; i < t->n_ops; ++i) {
+		MsgOp const*   op  = &t->op[i];
+		const uint8_t* val = (const uint8_t*)in->values + op->arg;
+		switch ((MsgOpKind)op->kind) {
+			case MT_TEXT:
+				mt_put (&o, t->text + op->arg, op->len);
+				break;
+			case MT_BOOL:
+				if (*(const bool*)val) {
+					mt_put (&o, "yes", 3);
+				} else {
+					mt_put (&o, "no", 2);
+				}
+				break;
+			case MT_INT: {
+				int32_t v;
+				memcpy (&v, val, sizeof (v));
+				mt_put_int (&o, v);
+			} break;
+			case MT_FLOAT: {
+				float v;
+				memcpy (&v, val, sizeof (v));
+				mt_put_float (&o, v, op->prec);
+			} break;
+			case MT_LEVEL:
+				mt_put_float (&o, in->level, op->prec);
+				break;
+			case MT_BAR:
+				mt_put_int (&o, in->bar);
+				break;
+			case MT_BEAT:
+				mt_put_float (&o, in->beat, op->prec);
+				break;
+			case MT_REQUESTS:
+				mt_put_uint (&o, in->requests, 1);
+				break;
+		}
+	}
+	buf[o.n] = '\0';
+	return buf;
+}
+
+#endif
@@ -0,0 +1,19 @@
+# Plugin parameters (patch:writable), single source for
+#  - the lv2:Parameter definitions in the plugin's .ttl
+#  - the constant parameter table in parameters.h
+#
+# symbol|type|minimum|maximum|default|label|comment[|enumeration[|cache]]
+#
+# type: Bool, Int, Float (stored in ReqValParamValues) or Path (not stored)
+# minimum, maximum: values outside the range are clamped
+# enumeration: "value:label,value:label,..", other values are rejected
+# cache: answers are re-used for scheduled requests, and saved with the
+#   session: "forever", <seconds> to expire, or "session" (not saved)
+# adding a line here is all that is needed for a new parameter to be
+# announced, decoded and stored.
+
+booltest|Bool|||0|Give me a B, give me an O, give me an O, give me a L!|Test dialog with boolean return value||86400
+gain|Float|-60|12|0|Gain|Output gain in dB
+lookahead|Bool|||0|Lookahead|Delay audio by 10 ms, so that changes triggered by the sidechain apply before the transient
+curve|Path||||Transfer Curve|Text file with whitespace separated values, mapping the input range -1..+1 to output
+rules|Path||||Trigger Rules|Text file with trigger rules, one per line, see src/rules.h
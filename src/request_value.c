@@ -14,69 +14,250 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#define REQVAL_URI "http://gareus.org/oss/lv2/request_value"
-
 #include <math.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <lv2/lv2plug.in/ns/ext/atom/atom.h>
 #include <lv2/lv2plug.in/ns/ext/atom/forge.h>
 #include <lv2/lv2plug.in/ns/ext/log/logger.h>
-#include <lv2/lv2plug.in/ns/ext/patch/patch.h>
+#include <lv2/lv2plug.in/ns/ext/state/state.h>
+#include <lv2/lv2plug.in/ns/ext/time/time.h>
 #include <lv2/lv2plug.in/ns/ext/urid/urid.h>
-#include <lv2/lv2plug.in/ns/extensions/ui/ui.h>
+#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
 #include <lv2/lv2plug.in/ns/lv2core/lv2.h>
 
-/* custom extension */
-#define LV2_DIALOGMESSAGE_URI "http://ardour.org/lv2/dialog_message"
+#ifdef DISPLAY_INTERFACE
+#include <cairo/cairo.h>
+#endif
+
+#include "dbtable.h"
+#include "delayline.h"
+#include "evmerge.h"
+#include "metrics.h"
+#include "msgtemplate.h"
+#include "parameters.h"
+#include "reqval_client.h"
+#include "rules.h"
+#include "seqlock.h"
+#include "timedqueue.h"
+#include "trace.h"
+#include "uris.h"
+#include "watchdog.h"
+#include "workflow.h"
+#include "workthread.h"
+
+#ifdef DISPLAY_INTERFACE
+#define LV2_INLINEDISPLAY_URI "http://harrisonconsoles.com/lv2/inlinedisplay"
+#define LV2_INLINEDISPLAY__interface LV2_INLINEDISPLAY_URI "#interface"
+#define LV2_INLINEDISPLAY__queue_draw LV2_INLINEDISPLAY_URI "#queue_draw"
+
+typedef void* LV2_Inline_Display_Handle;
 
 typedef struct {
-  void (*free_msg)(char const* msg);
+	unsigned char* data;
+	int            width;
+	int            height;
+	int            stride;
+} LV2_Inline_Display_Image_Surface;
 
-  char const* msg;
-  bool requires_return;
+typedef struct {
+	LV2_Inline_Display_Handle handle;
+	void (*queue_draw) (LV2_Inline_Display_Handle handle);
+} LV2_Inline_Display;
 
-} LV2_Dialog_Message;
+typedef struct {
+	LV2_Inline_Display_Image_Surface* (*render) (LV2_Handle instance, uint32_t w, uint32_t h);
+} LV2_Inline_Display_Interface;
+#endif
 
 typedef struct {
 	LV2_URID atom_Blank;
 	LV2_URID atom_Object;
-	LV2_URID atom_URID;
+	LV2_URID atom_Path;
 	LV2_URID atom_Float;
-	LV2_URID atom_Bool;
-	LV2_URID patch_Set;
-	LV2_URID patch_property;
-	LV2_URID patch_value;
-	LV2_URID m_bool_test;
+	LV2_URID atom_Long;
+	LV2_URID time_Position;
+	LV2_URID time_speed;
+	LV2_URID time_frame;
+	LV2_URID time_bar;
+	LV2_URID time_barBeat;
+	LV2_URID patch_Get;
 	LV2_URID m_ack_test;
+	LV2_URID m_curve_free;
+	LV2_URID m_curve_apply;
+	LV2_URID m_rules_load;
+	LV2_URID m_rules_free;
+	LV2_URID m_rules_apply;
+	LV2_URID m_log;
+	LV2_URID m_ui_on;
+	LV2_URID m_ui_off;
+	LV2_URID m_state;
+	LV2_URID m_n_requests;
+	LV2_URID m_n_answers;
+	LV2_URID m_pending;
+	LV2_URID m_have_answer;
+	LV2_URID m_last_answer;
+	LV2_URID m_latency;
+	LV2_URID m_n_clamped;
+	LV2_URID m_n_rejected;
+	LV2_URID m_n_cached;
+	LV2_URID m_load_level;
+	LV2_URID m_n_overruns;
+	LV2_URID m_history;
 } ReqValURIs;
 
-static void non_free (char const* msg)
-{
-#if 0 // statically allocated message
-	free (msg);
-#endif
-}
+/* transfer curve, loaded and free'd by the worker */
+typedef struct ReqValCurve {
+	struct ReqValCurve* retired; // next one to pass to the worker to free
+	uint32_t            n_points;
+	float               data[];
+} ReqValCurve;
+
+/* message passed between run() and the worker */
+typedef struct {
+	LV2_Atom     atom;
+	ReqValCurve* curve;
+} ReqValCurveMsg;
+
+typedef struct {
+	LV2_Atom     atom;
+	ReqValRules* rules;
+} ReqValRulesMsg;
+
+#define MAX_LOAD_PATH 1024
+
+/* file to load, the atom type tells a curve (atom:Path) from rules,
+ * the body is the terminated path */
+typedef struct {
+	LV2_Atom atom;
+	char     path[MAX_LOAD_PATH];
+} ReqValLoadMsg;
+
+#define MAX_LOG_MSG 256
+
+/* log message from run(), written by the worker */
+typedef struct {
+	LV2_Atom atom;
+	LV2_URID level;
+	char     text[MAX_LOG_MSG];
+} ReqValLogMsg;
+
+#define MAX_CURVE_POINTS 65536
+
+/* sidechain level that triggers a request, -6 dBFS */
+#define TRIGGER_THRESHOLD .5f
+
+/* TimedEvent types */
+enum {
+	TEV_REQUEST = 0,
+	TEV_WORKFLOW_TIMEOUT, // param: workflow index
+};
+
+/* time to wait for an answer to a workflow's question */
+#define WORKFLOW_TIMEOUT_MS 30000
+
+/* gain changes are interpolated over this time */
+#define GAIN_RAMP_MS 5
+
+/* lookahead, audio is delayed while the sidechain trigger is not */
+#define LOOKAHEAD_MS 10
+
+/* max rate of state updates sent to the UI(s) */
+#define NOTIFY_RATE_HZ 25
+
+/* request state, published by run() for non-realtime readers */
+typedef struct {
+	uint32_t n_requests;
+	uint32_t n_answers;
+	bool     pending;
+	bool     have_answer;
+	bool     last_answer;
+	float    latency; // seconds between last request and its answer
+	uint32_t n_clamped;  // parameter values limited to lv2:minimum/maximum
+	uint32_t n_rejected; // malformed or out-of-range parameter values
+	uint32_t n_cached;   // requests answered from the cache
+	uint32_t load_level; // WatchdogLevel
+	uint32_t n_overruns; // cycles that exceeded the budget
+} ReqValStatus;
+
+/* answer cache, the value is layout compatible with
+ * LV2_Atom_Bool, LV2_Atom_Int and LV2_Atom_Float */
+typedef struct {
+	LV2_Atom atom;
+	union {
+		int32_t i;
+		float   f;
+	} body;
+} ReqValCacheValue;
+
+typedef struct {
+	ReqValCacheValue value;
+	uint64_t         expires; // sample_cnt, UINT64_MAX: never
+	bool             valid;
+} ReqValCacheEntry;
+
+typedef struct {
+	ReqValCacheEntry entry[REQVAL_N_PARAMS];
+	uint64_t         now; // sample_cnt at the time of publishing
+} ReqValCache;
+
+/* answers received, most recent HISTORY_LEN */
+#define HISTORY_LEN 64
+
+typedef struct {
+	uint64_t         time; // sample_cnt
+	int32_t          param;
+	ReqValCacheValue value;
+} ReqValHistoryEntry;
+
+typedef struct {
+	ReqValHistoryEntry entry[HISTORY_LEN];
+	uint32_t           n_written; // free-running
+} ReqValHistory;
+
+/* patch:Get reply in progress, the notify buffer may not hold all
+ * of it, so it is continued in subsequent cycles */
+#define DUMP_MAX_PER_CYCLE 16
+#define DUMP_ITEM_SIZE 128 // upper bound of a forged message, incl. event header
+
+typedef struct {
+	bool     active;
+	int32_t  param; // next parameter
+	int32_t  param_end;
+	uint32_t hist; // next history entry, see ReqValHistory::n_written
+	uint32_t hist_end;
+} ReqValDump;
 
 typedef struct {
 	/* ports */
 	const LV2_Atom_Sequence* control;
+	LV2_Atom_Sequence*       notify;
 
 	float const* p_in;
 	float*       p_out;
+	float const* p_sc;
+	float*       p_latency;
 
 	/* LV2 Output */
 	LV2_Log_Log*   log;
 	LV2_Log_Logger logger;
 
+	/* atom-forge, notify UI */
+	LV2_Atom_Forge       forge;
+	LV2_Atom_Forge_Frame frame;
+
+	/* worker, provided by the host or the fallback thread */
+	LV2_Worker_Schedule* schedule;
+	WorkThread           workthread;
+
 	/* request param */
-	LV2UI_Request_Value* request_value;
-	LV2_Feature**        features;
-	LV2_Feature          dialog_feature;
-	LV2_Dialog_Message   dialog_message;
+	RVC_Client        rvc;
+	ReqValParamValues params;
 
 	/* settings, config */
 	ReqValURIs uris;
@@ -84,8 +265,93 @@ typedef struct {
 
 	/* state */
 	uint64_t sample_cnt;
-	bool     request_sent;
+	uint64_t request_time;
+	uint64_t event_time; // sample time of the event being dispatched
+	bool     awaiting[REQVAL_N_PARAMS]; // issued requests, not yet answered
+
+	/* internal events, due at a given sample time */
+	TimedQueue timed;
+
+	/* multi-step dialogs */
+	WorkflowEngine workflows;
+
+	/* sidechain trigger, on self->level */
+	bool sc_armed;
+
+	ReqValCurve* curve;
+
+	/* trigger rules */
+	ReqValRules* rules;
+
+	/* replaced ones, not yet passed to the worker to free */
+	ReqValCurve* retired_curves;
+	ReqValRules* retired_rules;
+
+	/* transport, input level, for rules and dialog messages */
+	bool    rolling;
+	int64_t bar;
+	float   beat;
+	float   level; // block peak, linear
+
+	/* dialog messages, rendered when a request is queued */
+	MsgTemplate hello;
+
+	/* lookahead delay */
+	DelayLine delay;
+	bool      lookahead;
+
+	/* output gain, linear, ramped over gain_ramp_len samples */
+	float    gain;
+	float    gain_target;
+	float    gain_step;
+	uint32_t gain_ramp;
+	uint32_t gain_ramp_len;
+	DbTable  dbtable;
+
+	/* answers, reported on patch:Get */
+	ReqValHistory history;
+	ReqValDump    dump;
+
+	/* answer cache, published for state save */
+	ReqValCache cache;
+	ReqValCache cache_pub;
+	SeqLock     cache_lock;
+	bool        cache_dirty;
+	LV2_URID    cache_key[REQVAL_N_PARAMS];
+	LV2_URID    cache_expires_key[REQVAL_N_PARAMS];
+
+	/* published state */
+	ReqValStatus status;
+	ReqValStatus status_pub;
+	SeqLock      status_lock;
+	bool         status_dirty;
+
+	/* overrun detection, degradation */
+	Watchdog watchdog;
+
+	/* counters, published every cycle while the exporter runs */
+	Metrics         metrics;
+	Metrics         metrics_pub;
+	SeqLock         metrics_lock;
+	MetricsExporter exporter;
+
+	/* UI notification */
+	uint32_t ui_active;
+	bool     ui_dirty;
+	uint32_t notify_interval;
+	uint32_t notify_countdown;
+
+#ifdef REQVAL_TRACE
+	Tracer tracer;
+#endif
 
+#ifdef DISPLAY_INTERFACE
+	LV2_Inline_Display*              queue_draw;
+	LV2_Inline_Display_Image_Surface surf;
+	cairo_surface_t*                 display;
+	uint32_t                         display_gen;
+	uint32_t                         w, h;
+#endif
 } ReqVal;
 
 static void
@@ -93,14 +359,99 @@ map_uris (LV2_URID_Map* map, ReqValURIs* uris)
 {
 	uris->atom_Blank     = map->map (map->handle, LV2_ATOM__Blank);
 	uris->atom_Object    = map->map (map->handle, LV2_ATOM__Object);
-	uris->atom_URID      = map->map (map->handle, LV2_ATOM__URID);
+	uris->atom_Path      = map->map (map->handle, LV2_ATOM__Path);
 	uris->atom_Float     = map->map (map->handle, LV2_ATOM__Float);
-	uris->atom_Bool      = map->map (map->handle, LV2_ATOM__Bool);
-	uris->patch_Set      = map->map (map->handle, LV2_PATCH__Set);
-	uris->patch_property = map->map (map->handle, LV2_PATCH__property);
-	uris->patch_value    = map->map (map->handle, LV2_PATCH__value);
-	uris->m_bool_test    = map->map (map->handle, REQVAL_URI "#booltest");
-	uris->m_ack_test     = map->map (map->handle, REQVAL_URI "#acktest");
+	uris->atom_Long      = map->map (map->handle, LV2_ATOM__Long);
+	uris->time_Position  = map->map (map->handle, LV2_TIME__Position);
+	uris->time_speed     = map->map (map->handle, LV2_TIME__speed);
+	uris->time_frame     = map->map (map->handle, LV2_TIME__frame);
+	uris->time_bar       = map->map (map->handle, LV2_TIME__bar);
+	uris->time_barBeat   = map->map (map->handle, LV2_TIME__barBeat);
+	uris->patch_Get      = map->map (map->handle, LV2_PATCH__Get);
+	uris->m_ack_test     = map->map (map->handle, REQVAL__acktest);
+	uris->m_curve_free   = map->map (map->handle, REQVAL_URI "#curve_free");
+	uris->m_curve_apply  = map->map (map->handle, REQVAL_URI "#curve_apply");
+	uris->m_rules_load   = map->map (map->handle, REQVAL_URI "#rules_load");
+	uris->m_rules_free   = map->map (map->handle, REQVAL_URI "#rules_free");
+	uris->m_rules_apply  = map->map (map->handle, REQVAL_URI "#rules_apply");
+	uris->m_log          = map->map (map->handle, REQVAL_URI "#log");
+	uris->m_ui_on        = map->map (map->handle, REQVAL__ui_on);
+	uris->m_ui_off       = map->map (map->handle, REQVAL__ui_off);
+	uris->m_state        = map->map (map->handle, REQVAL__state);
+	uris->m_n_requests   = map->map (map->handle, REQVAL__n_requests);
+	uris->m_n_answers    = map->map (map->handle, REQVAL__n_answers);
+	uris->m_pending      = map->map (map->handle, REQVAL__pending);
+	uris->m_have_answer  = map->map (map->handle, REQVAL__have_answer);
+	uris->m_last_answer  = map->map (map->handle, REQVAL__last_answer);
+	uris->m_latency      = map->map (map->handle, REQVAL__latency);
+	uris->m_n_clamped    = map->map (map->handle, REQVAL__n_clamped);
+	uris->m_n_rejected   = map->map (map->handle, REQVAL__n_rejected);
+	uris->m_n_cached     = map->map (map->handle, REQVAL__n_cached);
+	uris->m_load_level   = map->map (map->handle, REQVAL__load_level);
+	uris->m_n_overruns   = map->map (map->handle, REQVAL__n_overruns);
+	uris->m_history      = map->map (map->handle, REQVAL__history);
+}
+
+static const void* extension_data (const char* uri);
+
+/* ****************************************************************************
+ * Workflows, see workflow.h
+ */
+
+/* issue a workflow's request and arm the step's timeout */
+static bool
+workflow_ask (ReqVal* self, WorkflowState* wf, int param, char const* msg, uint32_t timeout_ms)
+{
+	const TimedEvent tev = {
+		self->event_time + (uint64_t)(timeout_ms * self->sample_rate / 1000.0),
+		0, TEV_WORKFLOW_TIMEOUT, (int32_t)(wf - self->workflows.state), RVC_PRIO_CRITICAL, false, NULL
+	};
+
+	/* bypass the cache, a workflow only proceeds on patch:Set.
+	 * Only post the timeout once the request is queued, so that a
+	 * failed attempt does not hold a slot of the timed queue */
+	if (self->timed.n_events >= TQ_MAX_EVENTS || RVC_OK != rvc_enqueue_prio (&self->rvc, RVC_PRIO_NORMAL, param, msg, true)) {
+		return false;
+	}
+	tq_post (&self->timed, &tev);
+	wf_await (wf, param, tev.time);
+	return true;
+}
+
+/* ask to adjust the output level, and for lookahead if the gain may clip */
+static WorkflowResult
+wf_setup (WorkflowState* wf, void* arg)
+{
+	ReqVal* self = (ReqVal*)arg;
+
+	WF_BEGIN (wf);
+
+	WF_AWAIT (wf, workflow_ask (self, wf, REQVAL_P_booltest, "Adjust the output level?", WORKFLOW_TIMEOUT_MS));
+	if (wf->timed_out || !self->params.booltest) {
+		WF_EXIT (wf);
+	}
+
+	WF_AWAIT (wf, workflow_ask (self, wf, REQVAL_P_gain, "Output gain", WORKFLOW_TIMEOUT_MS));
+	if (wf->timed_out || self->params.gain <= 0 || self->lookahead) {
+		WF_EXIT (wf);
+	}
+
+	WF_AWAIT (wf, workflow_ask (self, wf, REQVAL_P_lookahead, "Positive gain may clip, enable lookahead?", WORKFLOW_TIMEOUT_MS));
+
+	WF_END (wf);
+}
+
+static const WorkflowDesc reqval_workflows[] = {
+	{ "setup", wf_setup },
+};
+
+#define REQVAL_N_WORKFLOWS (sizeof (reqval_workflows) / sizeof (reqval_workflows[0]))
+
+static bool
+start_workflow (void* arg, int workflow)
+{
+	ReqVal* self = (ReqVal*)arg;
+	return wf_start (&self->workflows, workflow, self);
 }
 
 static LV2_Handle
@@ -109,24 +460,31 @@ instantiate (const LV2_Descriptor*     descriptor,
              const char*               bundle_path,
              const LV2_Feature* const* features)
 {
-	ReqVal*       self = (ReqVal*)calloc (1, sizeof (ReqVal));
-	LV2_URID_Map* map  = NULL;
+	ReqVal* self = (ReqVal*)calloc (1, sizeof (ReqVal));
+
+	/* urid:map, ui:requestValue */
+	rvc_init (&self->rvc, features);
+
+	LV2_URID_Map* map = self->rvc.map;
 
 	int i;
 	for (i = 0; features[i]; ++i) {
-		if (!strcmp (features[i]->URI, LV2_URID__map)) {
-			map = (LV2_URID_Map*)features[i]->data;
-		} else if (!strcmp (features[i]->URI, LV2_LOG__log)) {
+		if (!strcmp (features[i]->URI, LV2_LOG__log)) {
 			self->log = (LV2_Log_Log*)features[i]->data;
-		} else if (!strcmp (features[i]->URI, LV2_UI__requestValue)) {
-			self->request_value = (LV2UI_Request_Value*)features[i]->data;
+		} else if (!strcmp (features[i]->URI, LV2_WORKER__schedule)) {
+			self->schedule = (LV2_Worker_Schedule*)features[i]->data;
 		}
+#ifdef DISPLAY_INTERFACE
+		else if (!strcmp (features[i]->URI, LV2_INLINEDISPLAY__queue_draw)) {
+			self->queue_draw = (LV2_Inline_Display*)features[i]->data;
+		}
+#endif
 	}
 
 	/* Initialise logger (if map is unavailable, will fallback to printf) */
 	lv2_log_logger_init (&self->logger, map, self->log);
 
-	if (!self->request_value) {
+	if (!self->rvc.request_value) {
 		lv2_log_error (&self->logger, "ReqVal.lv2: Host does not support ui:request_value\n");
 		free (self);
 		return NULL;
@@ -139,20 +497,68 @@ instantiate (const LV2_Descriptor*     descriptor,
 	}
 
 	map_uris (map, &self->uris);
+	lv2_atom_forge_init (&self->forge, map);
+
+	if (!delayline_init (&self->delay, rint (rate * LOOKAHEAD_MS / 1000.0))) {
+		lv2_log_error (&self->logger, "ReqVal.lv2: Cannot allocate lookahead buffer\n");
+		free (self);
+		return NULL;
+	}
+
+	rvc_register_table (&self->rvc, reqval_params, REQVAL_N_PARAMS);
+
+	for (uint32_t i = 0; i < REQVAL_N_PARAMS; ++i) {
+		char        uri[256];
+		const char* sym = strrchr (reqval_params[i].uri, '#') + 1;
+		snprintf (uri, sizeof (uri), REQVAL_URI "#cache_%s", sym);
+		self->cache_key[i] = map->map (map->handle, uri);
+		snprintf (uri, sizeof (uri), REQVAL_URI "#cache_expires_%s", sym);
+		self->cache_expires_key[i] = map->map (map->handle, uri);
+	}
+	dbt_init (&self->dbtable);
+
+	self->params      = reqval_param_defaults;
+	self->gain_target = dbt_to_gain (&self->dbtable, self->params.gain);
+	self->gain        = self->gain_target;
+
+	self->gain_ramp_len = rint (rate * GAIN_RAMP_MS / 1000.0);
+	if (self->gain_ramp_len < 1) {
+		self->gain_ramp_len = 1;
+	}
+
+	self->notify_interval = rate / NOTIFY_RATE_HZ;
 
 	self->sample_rate  = rate;
 	self->sample_cnt   = 0;
-	self->request_sent = false;
+	self->sc_armed     = true;
+
+	tq_init (&self->timed);
 
-	self->dialog_message.msg = NULL;
-	self->dialog_message.requires_return = true;
-	self->dialog_message.free_msg = non_free;
+	mt_compile (&self->hello, "FOO BAR! Gain is {gain:1} dB, input level {level:1} dBFS", reqval_params, REQVAL_N_PARAMS);
+
+	const TimedEvent hello = { 2 * rate, 0, TEV_REQUEST, REQVAL_P_booltest, RVC_PRIO_BACKGROUND, false, &self->hello };
+	tq_post (&self->timed, &hello);
+
+	wf_init (&self->workflows, reqval_workflows, REQVAL_N_WORKFLOWS);
+
+#ifdef REQVAL_TRACE
+	if (!trace_init (&self->tracer)) {
+		lv2_log_warning (&self->logger, "ReqVal.lv2: Cannot initialize tracing\n");
+	}
+#endif
 
-	self->dialog_feature.URI  = LV2_DIALOGMESSAGE_URI;
-	self->dialog_feature.data = &self->dialog_message;
+	if (!self->schedule) {
+		if (workthread_start (&self->workthread, (LV2_Worker_Interface const*)extension_data (LV2_WORKER__interface), self)) {
+			self->schedule = &self->workthread.schedule;
+		} else {
+			lv2_log_warning (&self->logger, "ReqVal.lv2: Host does not support worker:schedule, file parameters are disabled\n");
+		}
+	}
 
-	self->features = (LV2_Feature**)calloc(2, sizeof(LV2_Feature*));
-	self->features[0] = &self->dialog_feature;
+	const char* metrics_dir = getenv ("REQVAL_METRICS_DIR");
+	if (metrics_dir && *metrics_dir && !metrics_start (&self->exporter, metrics_dir, &self->metrics_pub, &self->metrics_lock)) {
+		lv2_log_warning (&self->logger, "ReqVal.lv2: Cannot write metrics to '%s'\n", metrics_dir);
+	}
 
 	return (LV2_Handle)self;
 }
@@ -165,117 +571,1309 @@ connect_port (LV2_Handle instance,
 	ReqVal* self = (ReqVal*)instance;
 
 	switch (port) {
-		case 0:
+		case REQVAL_CONTROL:
 			self->control = (const LV2_Atom_Sequence*)data;
 			break;
-		case 1:
+		case REQVAL_INPUT:
 			self->p_in = (const float*)data;
 			break;
-		case 2:
+		case REQVAL_OUTPUT:
 			self->p_out = (float*)data;
 			break;
+		case REQVAL_NOTIFY:
+			self->notify = (LV2_Atom_Sequence*)data;
+			break;
+		case REQVAL_SIDECHAIN:
+			self->p_sc = (const float*)data;
+			break;
+		case REQVAL_LATENCY:
+			self->p_latency = (float*)data;
+			break;
 		default:
 			break;
 	}
 }
 
-static inline bool
-parse_property (ReqVal* self, const LV2_Atom_Object* obj)
+/* realtime-safe logging, the message is formatted in place
+ * and passed to the worker, which writes it to the host's log */
+static void
+rt_log (ReqVal* self, LV2_URID level, const char* fmt, ...)
 {
-	const LV2_Atom* property = NULL;
-	lv2_atom_object_get (obj, self->uris.patch_property, &property, 0);
+	va_list args;
+	va_start (args, fmt);
 
-	/* Get property URI.
-	 *
-	 * Note: Real world code would only call
-	 *  if (!property || property->type != self->uris.atom_URID) { return; }
-	 * However this is example and test code, so..
-	 */
-	if (!property) {
-		lv2_log_error (&self->logger, "ReqVal.lv2: Malformed set message has no body.\n");
-		return false;
-	} else if (property->type != self->uris.atom_URID) {
-		lv2_log_error (&self->logger, "ReqVal.lv2: Malformed set message has non-URID property.\n");
-		return false;
+	if (!self->schedule) {
+		lv2_log_vprintf (&self->logger, level, fmt, args);
+		va_end (args);
+		return;
 	}
 
-	/* Get value */
-	const LV2_Atom* val = NULL;
-	lv2_atom_object_get (obj, self->uris.patch_value, &val, 0);
-	if (!val) {
-		lv2_log_error (&self->logger, "ReqVal.lv2: Malformed set message has no value.\n");
-		return false;
+	ReqValLogMsg msg;
+	int          len = vsnprintf (msg.text, sizeof (msg.text), fmt, args);
+	va_end (args);
+
+	if (len < 0) {
+		return;
+	}
+	if (len >= MAX_LOG_MSG) {
+		len = MAX_LOG_MSG - 1;
+	}
+	msg.atom.type = self->uris.m_log;
+	msg.atom.size = sizeof (LV2_URID) + len + 1;
+	msg.level     = level;
+	self->schedule->schedule_work (self->schedule->handle, sizeof (LV2_Atom) + msg.atom.size, &msg);
+}
+
+static void
+answer_received (ReqVal* self, bool b)
+{
+	rt_log (self, self->logger.Note, "ReqVal.lv2: Received boolean = %d\n", b);
+
+	if (self->status.pending) {
+		self->status.pending = false;
+		self->status.latency = (self->sample_cnt - self->request_time) / self->sample_rate;
+		metrics_observe (&self->metrics.latency, metrics_latency_le, self->status.latency);
+	}
+	self->status.have_answer = true;
+	self->status.last_answer = b;
+	++self->status.n_answers;
+	self->status_dirty = true;
+}
+
+/* a request for `param` will not be answered: the host rejected it,
+ * or the workflow step that asked timed out */
+static void
+request_dropped (ReqVal* self, int param)
+{
+	self->awaiting[param] = false;
+	if (param == REQVAL_P_booltest && self->status.pending) {
+		self->status.pending = false;
+		self->status_dirty   = true;
 	}
+}
+
+static bool set_param (ReqVal* self, int param, const LV2_Atom* val);
+static void cache_store (ReqVal* self, int param);
+static void history_add (ReqVal* self, int param);
+
+static inline bool
+parse_property (ReqVal* self, const LV2_Atom_Object* obj)
+{
+	const LV2_Atom* val = NULL;
 
 	/* NOTE: This code errs towards the verbose side
 	 *  - the type is usually implicit and does not need to be checked.
-	 *  - consolidate code e.g.
-	 *
-	 *    const LV2_URID urid = (LV2_Atom_URID*)property)->body
-	 *    ReqValURIs* urid    = self->uris;
-	 *
-	 *  - no need to lv2_log warnings or errors
+	 *  - no need to log warnings or errors
 	 */
+	const int param = rvc_decode (&self->rvc, obj, &val);
 
-	if (((LV2_Atom_URID*)property)->body == self->uris.m_bool_test) {
-		if (val->type != self->uris.atom_Bool) {
-			lv2_log_error (&self->logger, "ReqVal.lv2: Invalid property type, expected 'bool'.\n");
+	if (param < 0) {
+		++self->status.n_rejected;
+		self->status_dirty = true;
+	}
+
+	switch (param) {
+		case RVC_ERR_NO_BODY:
+			rt_log (self, self->logger.Error, "ReqVal.lv2: Malformed set message has no body.\n");
 			return false;
-		}
-		bool b = *((bool*)(val + 1));
-		lv2_log_note (&self->logger, "ReqVal.lv2: Received boolean = %d\n", b);
-	} else {
-		lv2_log_error (&self->logger, "ReqVal.lv2: Set message for unknown property.\n");
+		case RVC_ERR_NOT_URID:
+			rt_log (self, self->logger.Error, "ReqVal.lv2: Malformed set message has non-URID property.\n");
+			return false;
+		case RVC_ERR_NO_VALUE:
+			rt_log (self, self->logger.Error, "ReqVal.lv2: Malformed set message has no value.\n");
+			return false;
+		case RVC_ERR_TYPE:
+			rt_log (self, self->logger.Error, "ReqVal.lv2: Invalid property type.\n");
+			return false;
+		case RVC_ERR_UNKNOWN:
+			rt_log (self, self->logger.Error, "ReqVal.lv2: Set message for unknown property.\n");
+			return false;
+		default:
+			break;
+	}
+
+	TRACE (self, TRACE_SET, param);
+
+	if (!set_param (self, param, val)) {
 		return false;
 	}
+
+	/* only a value that follows a request is an answer,
+	 * not a change made by the UI or host automation */
+	if (self->awaiting[param]) {
+		self->awaiting[param] = false;
+		if (param == REQVAL_P_booltest) {
+			answer_received (self, self->params.booltest);
+		}
+		if (reqval_cache_ttl[param] != 0) {
+			cache_store (self, param);
+		}
+	}
+	if (reqval_params[param].offset >= 0) {
+		history_add (self, param);
+	}
+
+	wf_answer (&self->workflows, param, self);
 	return true;
 }
 
+/* the current value of a stored parameter as atom */
 static void
-run (LV2_Handle instance, uint32_t n_samples)
+param_value (ReqVal const* self, int param, ReqValCacheValue* v)
 {
-	ReqVal* self = (ReqVal*)instance;
+	const uint8_t* src = (const uint8_t*)&self->params + reqval_params[param].offset;
+
+	v->atom.type = self->rvc.params[param].type;
+	v->atom.size = sizeof (int32_t);
 
-	/* just forward all audio */
-	if (self->p_out != self->p_in) {
-		memcpy (self->p_out, self->p_in, sizeof (float) * n_samples);
+	if (reqval_params[param].kind == RVC_BOOL) {
+		v->body.i = *(const bool*)src;
+	} else {
+		memcpy (&v->body, src, sizeof (int32_t));
 	}
+}
 
-	if (!self->control) {
-		return;
+static void
+history_add (ReqVal* self, int param)
+{
+	ReqValHistoryEntry* e = &self->history.entry[self->history.n_written++ % HISTORY_LEN];
+	e->time               = self->event_time;
+	e->param              = param;
+	param_value (self, param, &e->value);
+}
+
+static void
+cache_store (ReqVal* self, int param)
+{
+	ReqValCacheEntry* e   = &self->cache.entry[param];
+	const int32_t     ttl = reqval_cache_ttl[param];
+
+	param_value (self, param, &e->value);
+
+	e->expires = ttl > 0 ? self->sample_cnt + (uint64_t)ttl * self->sample_rate : UINT64_MAX;
+	e->valid   = true;
+
+	self->cache_dirty = true;
+}
+
+static ReqValCacheValue const*
+cache_lookup (ReqVal* self, int param)
+{
+	ReqValCacheEntry* e = &self->cache.entry[param];
+	if (!e->valid) {
+		return NULL;
+	}
+	if (e->expires <= self->sample_cnt) {
+		e->valid          = false;
+		self->cache_dirty = true;
+		return NULL;
 	}
+	return &e->value;
+}
 
-	/* process control events */
-	LV2_ATOM_SEQUENCE_FOREACH (self->control, ev)
-	{
-		if (ev->body.type != self->uris.atom_Object) {
-			continue;
+/* render into the buffer of a queued request */
+static void
+render_message (ReqVal* self, MsgTemplate const* msg, char* buf)
+{
+	MsgInput in;
+	in.values   = &self->params;
+	in.level    = dbt_to_db (&self->dbtable, self->level);
+	in.bar      = self->bar;
+	in.beat     = self->beat;
+	in.requests = self->status.n_requests;
+	mt_render (msg, &in, buf);
+}
+
+/* queue a request, unless a valid answer is cached.
+ * The message is only rendered once the request is queued */
+static RVC_Status
+schedule_request (void* arg, RVC_Priority prio, int param, MsgTemplate const* msg, bool requires_return)
+{
+	ReqVal*                 self = (ReqVal*)arg;
+	ReqValCacheValue const* v    = param >= 0 && param < REQVAL_N_PARAMS ? cache_lookup (self, param) : NULL;
+
+	if (!v) {
+		if (param < 0 || (uint32_t)param >= self->rvc.n_params) {
+			return RVC_ERR_UNKNOWN;
 		}
-		const LV2_Atom_Object* obj = (LV2_Atom_Object*)&ev->body;
-		if (obj->body.otype == self->uris.patch_Set) {
-			parse_property (self, obj);
+		char* buf = rvc_enqueue_msg (&self->rvc, prio, param, requires_return);
+		if (!buf) {
+			return RVC_ERR_NOSPACE;
 		}
+		render_message (self, msg, buf);
+		return RVC_OK;
+	}
+
+	set_param (self, param, &v->atom);
+	++self->status.n_cached;
+	self->status_dirty = true;
+	return RVC_OK;
+}
+
+/* pass the path of a file to load to the worker, as a message of the
+ * given type. The path is copied and terminated, it may come from
+ * the UI or host unchecked */
+static bool
+schedule_load (ReqVal* self, LV2_URID type, const LV2_Atom* val)
+{
+	if (!self->schedule) {
+		rt_log (self, self->logger.Error, "ReqVal.lv2: Cannot load file without worker.\n");
+		return false;
+	}
+	if (val->size == 0 || val->size > MAX_LOAD_PATH) {
+		rt_log (self, self->logger.Error, "ReqVal.lv2: Invalid path.\n");
+		return false;
+	}
+	ReqValLoadMsg msg;
+	msg.atom.type = type;
+	msg.atom.size = val->size;
+	memcpy (msg.path, LV2_ATOM_BODY_CONST (val), val->size);
+	msg.path[val->size - 1] = '\0';
+	if (self->schedule->schedule_work (self->schedule->handle, sizeof (LV2_Atom) + val->size, &msg) != LV2_WORKER_SUCCESS) {
+		rt_log (self, self->logger.Error, "ReqVal.lv2: Cannot pass '%s' to the worker.\n", msg.path);
+		return false;
 	}
+	return true;
+}
 
-	if (!self->request_sent && self->sample_cnt > 2 * self->sample_rate) {
-		self->request_sent = true;
-		self->dialog_message.msg = "FOO BAR!";
-		self->dialog_message.requires_return = false;
-		self->request_value->request (self->request_value->handle, self->uris.m_bool_test, self->uris.atom_Bool, (const LV2_Feature * const*)self->features);
+static bool
+set_param (ReqVal* self, int param, const LV2_Atom* val)
+{
+	/* plain values, no per-parameter code */
+	switch (rvc_store (&reqval_params[param], val, &self->params)) {
+		case RVC_ERR_RANGE:
+			rt_log (self, self->logger.Warning, "ReqVal.lv2: Value out of range.\n");
+			++self->status.n_rejected;
+			self->status_dirty = true;
+			return false;
+		case RVC_CLAMPED:
+			++self->status.n_clamped;
+			self->status_dirty = true;
+			break;
+		default:
+			break;
 	}
 
-	self->sample_cnt += n_samples;
+	/* parameters with side-effects */
+	switch (param) {
+		case REQVAL_P_lookahead:
+			if (self->params.lookahead && !self->lookahead) {
+				delayline_reset (&self->delay);
+			}
+			self->lookahead = self->params.lookahead;
+			break;
+		case REQVAL_P_gain:
+			self->gain_target = dbt_to_gain (&self->dbtable, self->params.gain);
+			self->gain_ramp   = self->gain_ramp_len;
+			self->gain_step   = (self->gain_target - self->gain) / self->gain_ramp;
+			break;
+		case REQVAL_P_curve:
+			/* file I/O and allocation happen in the worker */
+			return schedule_load (self, self->uris.atom_Path, val);
+		case REQVAL_P_rules:
+			/* the worker compiles the rules */
+			return schedule_load (self, self->uris.m_rules_load, val);
+		default:
+			break;
+	}
+	return true;
 }
 
 static void
-cleanup (LV2_Handle instance)
+apply_curve (ReqValCurve const* curve, float const* in, float* out, uint32_t n_samples)
 {
-	free (instance);
+	const float    scale = .5f * (curve->n_points - 1);
+	const uint32_t last  = curve->n_points - 1;
+
+	for (uint32_t i = 0; i < n_samples; ++i) {
+		const float x = (fminf (1.f, fmaxf (-1.f, in[i])) + 1.f) * scale;
+		uint32_t    p = (uint32_t)x;
+		if (p >= last) {
+			p = last - 1;
+		}
+		const float f = x - p;
+		out[i]        = curve->data[p] + f * (curve->data[p + 1] - curve->data[p]);
+	}
 }
 
-static const void*
-extension_data (const char* uri)
+/* apply gain, interpolate linearly to the target. The ramp is
+ * stepped per sample, so the result does not depend on how the
+ * audio is split into cycles or segments */
+static void
+apply_gain (ReqVal* self, float* buf, uint32_t n_samples)
+{
+	uint32_t i = 0;
+
+	for (; i < n_samples && self->gain_ramp > 0; ++i) {
+		if (--self->gain_ramp == 0) {
+			self->gain = self->gain_target;
+		} else {
+			self->gain += self->gain_step;
+		}
+		buf[i] *= self->gain;
+	}
+
+	const float g = self->gain;
+	if (g != 1.f) {
+		for (; i < n_samples; ++i) {
+			buf[i] *= g;
+		}
+	}
+}
+
+/* block peak, four independent accumulators so that the
+ * compiler can vectorize the loop without re-association */
+static float
+detect_peak (float const* buf, uint32_t n_samples)
+{
+	float    p0 = 0, p1 = 0, p2 = 0, p3 = 0;
+	uint32_t i  = 0;
+	for (; i + 4 <= n_samples; i += 4) {
+		p0 = fmaxf (p0, fabsf (buf[i]));
+		p1 = fmaxf (p1, fabsf (buf[i + 1]));
+		p2 = fmaxf (p2, fabsf (buf[i + 2]));
+		p3 = fmaxf (p3, fabsf (buf[i + 3]));
+	}
+	for (; i < n_samples; ++i) {
+		p0 = fmaxf (p0, fabsf (buf[i]));
+	}
+	return fmaxf (fmaxf (p0, p1), fmaxf (p2, p3));
+}
+
+static void
+parse_position (ReqVal* self, const LV2_Atom_Object* obj)
 {
+	const LV2_Atom* speed = NULL;
+	const LV2_Atom* bar   = NULL;
+	const LV2_Atom* beat  = NULL;
+	lv2_atom_object_get (obj, self->uris.time_speed, &speed, self->uris.time_bar, &bar, self->uris.time_barBeat, &beat, 0);
+	if (speed && speed->type == self->uris.atom_Float) {
+		self->rolling = ((const LV2_Atom_Float*)speed)->body != 0;
+	}
+	if (bar && bar->type == self->uris.atom_Long) {
+		self->bar = ((const LV2_Atom_Long*)bar)->body;
+	}
+	if (beat && beat->type == self->uris.atom_Float) {
+		self->beat = ((const LV2_Atom_Float*)beat)->body;
+	}
+}
+
+static void
+tx_state (ReqVal* self)
+{
+	const ReqValStatus* st = &self->status;
+	LV2_Atom_Forge_Frame frame;
+	lv2_atom_forge_frame_time (&self->forge, 0);
+	lv2_atom_forge_object (&self->forge, &frame, 1, self->uris.m_state);
+	lv2_atom_forge_key (&self->forge, self->uris.m_n_requests);
+	lv2_atom_forge_int (&self->forge, st->n_requests);
+	lv2_atom_forge_key (&self->forge, self->uris.m_n_answers);
+	lv2_atom_forge_int (&self->forge, st->n_answers);
+	lv2_atom_forge_key (&self->forge, self->uris.m_pending);
+	lv2_atom_forge_bool (&self->forge, st->pending);
+	lv2_atom_forge_key (&self->forge, self->uris.m_have_answer);
+	lv2_atom_forge_bool (&self->forge, st->have_answer);
+	lv2_atom_forge_key (&self->forge, self->uris.m_last_answer);
+	lv2_atom_forge_bool (&self->forge, st->last_answer);
+	lv2_atom_forge_key (&self->forge, self->uris.m_latency);
+	lv2_atom_forge_float (&self->forge, st->latency);
+	lv2_atom_forge_key (&self->forge, self->uris.m_n_clamped);
+	lv2_atom_forge_int (&self->forge, st->n_clamped);
+	lv2_atom_forge_key (&self->forge, self->uris.m_n_rejected);
+	lv2_atom_forge_int (&self->forge, st->n_rejected);
+	lv2_atom_forge_key (&self->forge, self->uris.m_n_cached);
+	lv2_atom_forge_int (&self->forge, st->n_cached);
+	lv2_atom_forge_key (&self->forge, self->uris.m_load_level);
+	lv2_atom_forge_int (&self->forge, st->load_level);
+	lv2_atom_forge_key (&self->forge, self->uris.m_n_overruns);
+	lv2_atom_forge_int (&self->forge, st->n_overruns);
+	lv2_atom_forge_pop (&self->forge, &frame);
+}
+
+static void
+tx_param (ReqVal* self, int param)
+{
+	ReqValCacheValue     v;
+	LV2_Atom_Forge_Frame frame;
+	param_value (self, param, &v);
+	lv2_atom_forge_frame_time (&self->forge, 0);
+	lv2_atom_forge_object (&self->forge, &frame, 0, self->rvc.patch_Set);
+	lv2_atom_forge_key (&self->forge, self->rvc.patch_property);
+	lv2_atom_forge_urid (&self->forge, rvc_property (&self->rvc, param));
+	lv2_atom_forge_key (&self->forge, self->rvc.patch_value);
+	lv2_atom_forge_write (&self->forge, &v, sizeof (LV2_Atom) + v.atom.size);
+	lv2_atom_forge_pop (&self->forge, &frame);
+}
+
+static void
+tx_history (ReqVal* self, ReqValHistoryEntry const* e)
+{
+	LV2_Atom_Forge_Frame frame;
+	lv2_atom_forge_frame_time (&self->forge, 0);
+	lv2_atom_forge_object (&self->forge, &frame, 0, self->uris.m_history);
+	lv2_atom_forge_key (&self->forge, self->uris.time_frame);
+	lv2_atom_forge_long (&self->forge, e->time);
+	lv2_atom_forge_key (&self->forge, self->rvc.patch_property);
+	lv2_atom_forge_urid (&self->forge, rvc_property (&self->rvc, e->param));
+	lv2_atom_forge_key (&self->forge, self->rvc.patch_value);
+	lv2_atom_forge_write (&self->forge, &e->value, sizeof (LV2_Atom) + e->value.atom.size);
+	lv2_atom_forge_pop (&self->forge, &frame);
+}
+
+/* patch:Get, without property all parameters followed by the
+ * history, or a single parameter, or reqval:history only.
+ * A new request replaces one in progress. */
+static void
+dump_start (ReqVal* self, const LV2_Atom_Object* obj)
+{
+	ReqValDump*     d        = &self->dump;
+	const LV2_Atom* property = NULL;
+	lv2_atom_object_get (obj, self->rvc.patch_property, &property, 0);
+
+	const uint32_t n_hist = self->history.n_written;
+
+	d->active    = true;
+	d->param     = 0;
+	d->param_end = REQVAL_N_PARAMS;
+	d->hist      = n_hist > HISTORY_LEN ? n_hist - HISTORY_LEN : 0;
+	d->hist_end  = n_hist;
+
+	if (!property) {
+		return;
+	}
+
+	const LV2_URID key = property->type == self->rvc.atom_URID ? ((const LV2_Atom_URID*)property)->body : 0;
+	const int      p   = rvc_find (&self->rvc, key);
+
+	if (key == self->uris.m_history) {
+		d->param = d->param_end;
+	} else if (p >= 0) {
+		d->param     = p;
+		d->param_end = p + 1;
+		d->hist      = d->hist_end;
+	} else {
+		d->active = false;
+	}
+}
+
+/* forge the next part of a patch:Get reply, bounded by DUMP_MAX_PER_CYCLE
+ * and the space left in the notify buffer */
+static void
+dump_continue (ReqVal* self)
+{
+	ReqValDump*    d = &self->dump;
+	uint32_t const n_hist = self->history.n_written;
+
+	for (uint32_t n = 0; n < DUMP_MAX_PER_CYCLE;) {
+		if (self->forge.offset + DUMP_ITEM_SIZE > self->forge.size) {
+			return;
+		}
+		if (d->param < d->param_end) {
+			if (reqval_params[d->param].offset >= 0) {
+				tx_param (self, d->param);
+				++n;
+			}
+			++d->param;
+		} else if (d->hist != d->hist_end) {
+			/* skip entries that were overwritten meanwhile */
+			if (n_hist - d->hist > HISTORY_LEN) {
+				d->hist = n_hist - d->hist_end > HISTORY_LEN ? d->hist_end : n_hist - HISTORY_LEN;
+				continue;
+			}
+			tx_history (self, &self->history.entry[d->hist % HISTORY_LEN]);
+			++d->hist;
+			++n;
+		} else {
+			break;
+		}
+	}
+	if (d->param >= d->param_end && d->hist == d->hist_end) {
+		d->active = false;
+	}
+}
+
+/* process `n_samples` of audio, starting at `offset` */
+static void
+process_audio (ReqVal* self, uint32_t offset, uint32_t n_samples)
+{
+	float const* in  = self->p_in + offset;
+	float*       out = self->p_out + offset;
+
+	if (self->lookahead) {
+		/* delay first, the curve and gain are applied in-place */
+		delayline_process (&self->delay, in, out, n_samples);
+		in = out;
+	}
+
+	if (self->curve) {
+		apply_curve (self->curve, in, out, n_samples);
+	} else if (out != in) {
+		/* just forward all audio */
+		memcpy (out, in, sizeof (float) * n_samples);
+	}
+
+	apply_gain (self, out, n_samples);
+}
+
+/* event sources for the merge in run() */
+typedef struct {
+	const LV2_Atom_Sequence* seq;
+	const LV2_Atom_Event*    it;
+} SequenceSource;
+
+typedef struct {
+	TimedQueue* q;
+	uint64_t    start; // sample_cnt at the cycle start
+	uint64_t    end;
+	bool        defer; // postpone non-critical events to the next cycle
+	TimedEvent  cur;
+} TimedSource;
+
+static bool
+sequence_next (void* src, EvMergeEvent* ev)
+{
+	SequenceSource* s = (SequenceSource*)src;
+	if (lv2_atom_sequence_is_end (&s->seq->body, s->seq->atom.size, s->it)) {
+		return false;
+	}
+	ev->time = s->it->time.frames;
+	ev->data = s->it;
+	s->it    = lv2_atom_sequence_next (s->it);
+	return true;
+}
+
+static bool
+timed_next (void* src, EvMergeEvent* ev)
+{
+	TimedSource*      s = (TimedSource*)src;
+	TimedEvent const* head;
+	while ((head = tq_peek (s->q)) && head->time < s->end) {
+		tq_pop (s->q, &s->cur);
+		if (s->defer && s->cur.prio != RVC_PRIO_CRITICAL) {
+			/* the slot was just freed, this cannot fail */
+			s->cur.time = s->end;
+			tq_post (s->q, &s->cur);
+			continue;
+		}
+		/* overdue events are dispatched at the start of the cycle */
+		ev->time = s->cur.time > s->start ? (int64_t)(s->cur.time - s->start) : 0;
+		ev->data = &s->cur;
+		return true;
+	}
+	return false;
+}
+
+static void
+dispatch_atom (ReqVal* self, const LV2_Atom_Event* ev)
+{
+	if (ev->body.type != self->uris.atom_Object) {
+		return;
+	}
+	const LV2_Atom_Object* obj = (LV2_Atom_Object*)&ev->body;
+	if (obj->body.otype == self->rvc.patch_Set) {
+		TRACE (self, TRACE_DECODE_BEGIN, 0);
+		parse_property (self, obj);
+		TRACE (self, TRACE_DECODE_END, 0);
+	} else if (obj->body.otype == self->uris.patch_Get) {
+		dump_start (self, obj);
+	} else if (obj->body.otype == self->uris.time_Position) {
+		parse_position (self, obj);
+	} else if (obj->body.otype == self->uris.m_ui_on) {
+		++self->ui_active;
+		self->ui_dirty         = true;
+		self->notify_countdown = 0;
+	} else if (obj->body.otype == self->uris.m_ui_off) {
+		if (self->ui_active > 0) {
+			--self->ui_active;
+		}
+	}
+}
+
+static void
+dispatch_timed (ReqVal* self, TimedEvent const* ev)
+{
+	switch (ev->type) {
+		case TEV_REQUEST:
+			schedule_request (self, (RVC_Priority)ev->prio, ev->param, (MsgTemplate const*)ev->msg, ev->requires_return);
+			break;
+		case TEV_WORKFLOW_TIMEOUT: {
+			/* the awaited parameter, before the workflow moves on */
+			const int32_t param = ev->param >= 0 && (uint32_t)ev->param < self->workflows.n ? self->workflows.state[ev->param].param : -1;
+			if (wf_timeout (&self->workflows, ev->param, ev->time, self) && param >= 0) {
+				request_dropped (self, param);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/* the input level is only measured if something uses it:
+ * the sidechain trigger, rules, or the message of a request due in this cycle */
+static bool
+level_needed (ReqVal const* self, uint32_t n_samples)
+{
+	if (self->p_sc || self->rules) {
+		return true;
+	}
+	for (uint32_t i = 0; i < self->timed.n_events; ++i) {
+		TimedEvent const* ev = &self->timed.ev[i];
+		if (ev->type == TEV_REQUEST && ev->time < self->sample_cnt + n_samples && ((MsgTemplate const*)ev->msg)->uses_level) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+process_cycle (ReqVal* self, uint32_t n_samples)
+{
+	const uint32_t level = self->watchdog.level;
+
+	TRACE (self, TRACE_CYCLE_BEGIN, n_samples);
+
+	/* rules see the undelayed input, measure before in-place processing */
+	if (level_needed (self, n_samples)) {
+		self->level = detect_peak (self->p_sc ? self->p_sc : self->p_in, n_samples);
+	}
+
+	if (!self->control) {
+		if (n_samples > 0) {
+			process_audio (self, 0, n_samples);
+		}
+		if (self->p_latency) {
+			*self->p_latency = self->lookahead ? self->delay.len : 0;
+		}
+		TRACE (self, TRACE_CYCLE_END, 0);
+		return;
+	}
+
+	if (self->notify) {
+		const uint32_t capacity = self->notify->atom.size;
+		lv2_atom_forge_set_buffer (&self->forge, (uint8_t*)self->notify, capacity);
+		lv2_atom_forge_sequence_head (&self->forge, &self->frame, 0);
+	}
+
+	/* merge host events and due internal events into a single
+	 * time-ordered stream, host events first at equal times.
+	 * Audio is processed up to each event, so that parameter
+	 * changes are sample accurate. */
+	SequenceSource ctrl  = { self->control, lv2_atom_sequence_begin (&self->control->body) };
+	TimedSource    timed;
+	timed.q     = &self->timed;
+	timed.start = self->sample_cnt;
+	timed.end   = self->sample_cnt + n_samples;
+	timed.defer = level >= WD_DEFER;
+
+	EvMerge merge;
+	evm_init (&merge);
+	evm_add (&merge, sequence_next, &ctrl);
+	evm_add (&merge, timed_next, &timed);
+
+	uint32_t     offset = 0;
+	EvMergeEvent ev;
+	while (evm_pop (&merge, &ev)) {
+		uint32_t t = ev.time < 0 ? 0 : (ev.time > n_samples ? n_samples : (uint32_t)ev.time);
+		if (level >= WD_COARSE) {
+			t &= ~(WD_COARSE_GRID - 1);
+		}
+		if (t > offset) {
+			process_audio (self, offset, t - offset);
+			offset = t;
+		}
+		self->event_time = self->sample_cnt + t;
+		if (ev.source == 0) {
+			++self->metrics.n_host_events;
+			dispatch_atom (self, (const LV2_Atom_Event*)ev.data);
+		} else {
+			++self->metrics.n_internal_events;
+			dispatch_timed (self, (TimedEvent const*)ev.data);
+		}
+	}
+
+	if (offset < n_samples) {
+		process_audio (self, offset, n_samples - offset);
+	}
+
+	if (self->p_latency) {
+		*self->p_latency = self->lookahead ? self->delay.len : 0;
+	}
+
+	/* the sidechain is optional, when it is not connected
+	 * the audio path above is all that's done per sample */
+	if (self->p_sc) {
+		if (self->sc_armed && self->level >= TRIGGER_THRESHOLD) {
+			self->sc_armed = false;
+			rvc_enqueue_prio (&self->rvc, RVC_PRIO_CRITICAL, REQVAL_P_booltest, "Sidechain signal detected", true);
+		} else if (!self->sc_armed && !self->status.pending && !rvc_queued (&self->rvc) && self->level < TRIGGER_THRESHOLD) {
+			self->sc_armed = true;
+		}
+	}
+
+	if (self->rules) {
+		const RuleInput ri = { self->level, self->rolling, self->sample_cnt + n_samples, n_samples };
+		self->event_time = self->sample_cnt + n_samples;
+		rules_eval (self->rules, &ri, level >= WD_DEFER, schedule_request, start_workflow, self);
+	}
+
+	/* only a request that expects a reply is awaited, not e.g. the hello */
+	const int  issued   = rvc_issue (&self->rvc);
+	const bool expected = self->rvc.dialog_message.requires_return;
+	if (issued >= 0) {
+		TRACE (self, TRACE_REQUEST, issued);
+		++self->metrics.n_requests;
+		if (expected) {
+			self->awaiting[issued] = true;
+		}
+	} else if (issued == RVC_ERR_REJECTED) {
+		++self->metrics.n_host_rejected;
+		request_dropped (self, self->rvc.last_param);
+	}
+
+	if (issued == REQVAL_P_booltest) {
+		if (expected) {
+			self->request_time   = self->sample_cnt;
+			self->status.pending = true;
+		}
+		++self->status.n_requests;
+		self->status_dirty = true;
+	}
+
+	self->sample_cnt += n_samples;
+
+	/* responses of the fallback thread, hosts call work_response() after run() */
+	workthread_deliver (&self->workthread);
+
+	if (self->status_dirty) {
+		self->status_dirty = false;
+		seqlock_write_begin (&self->status_lock);
+		self->status_pub = self->status;
+		seqlock_write_end (&self->status_lock);
+		self->ui_dirty = true;
+#ifdef DISPLAY_INTERFACE
+		if (self->queue_draw) {
+			self->queue_draw->queue_draw (self->queue_draw->handle);
+		}
+#endif
+	}
+
+	if (self->cache_dirty) {
+		self->cache_dirty = false;
+		self->cache.now   = self->sample_cnt;
+		seqlock_write_begin (&self->cache_lock);
+		self->cache_pub = self->cache;
+		seqlock_write_end (&self->cache_lock);
+	}
+
+	/* coalesce UI updates, send at most NOTIFY_RATE_HZ */
+	if (self->notify_countdown > n_samples) {
+		self->notify_countdown -= n_samples;
+	} else {
+		self->notify_countdown = 0;
+	}
+
+	if (!self->notify) {
+		TRACE (self, TRACE_CYCLE_END, 0);
+		return;
+	}
+
+	if (self->ui_active && self->ui_dirty && self->notify_countdown == 0 && level < WD_DEFER) {
+		tx_state (self);
+		self->ui_dirty         = false;
+		self->notify_countdown = self->notify_interval;
+	}
+
+	if (self->dump.active && level < WD_DEFER) {
+		dump_continue (self);
+	}
+
+	lv2_atom_forge_pop (&self->forge, &self->frame);
+
+	TRACE (self, TRACE_CYCLE_END, 0);
+}
+
+static void
+publish_metrics (ReqVal* self, uint32_t n_samples)
+{
+	Metrics* m = &self->metrics;
+	if (n_samples > 0) {
+		metrics_observe (&m->run_cost, metrics_run_le, self->watchdog.cost * 1e-9);
+	}
+	m->n_answers  = self->status.n_answers;
+	m->n_cached   = self->status.n_cached;
+	m->n_clamped  = self->status.n_clamped;
+	m->n_rejected = self->status.n_rejected;
+	m->n_overruns = self->watchdog.n_overruns;
+	m->load_level = self->watchdog.level;
+
+	seqlock_write_begin (&self->metrics_lock);
+	self->metrics_pub = *m;
+	seqlock_write_end (&self->metrics_lock);
+}
+
+/* pass replaced curves and rules to the worker to free. Those that do
+ * not fit its queue are retried in the next cycle, or freed in cleanup */
+static void
+retire_flush (ReqVal* self)
+{
+	while (self->retired_curves) {
+		ReqValCurveMsg old;
+		old.atom.type = self->uris.m_curve_free;
+		old.atom.size = sizeof (ReqValCurve*);
+		old.curve     = self->retired_curves;
+		/* the worker may free it right away */
+		ReqValCurve* next = old.curve->retired;
+		if (self->schedule->schedule_work (self->schedule->handle, sizeof (old), &old) != LV2_WORKER_SUCCESS) {
+			break;
+		}
+		self->retired_curves = next;
+	}
+	while (self->retired_rules) {
+		ReqValRulesMsg old;
+		old.atom.type = self->uris.m_rules_free;
+		old.atom.size = sizeof (ReqValRules*);
+		old.rules     = self->retired_rules;
+		ReqValRules* next = old.rules->retired;
+		if (self->schedule->schedule_work (self->schedule->handle, sizeof (old), &old) != LV2_WORKER_SUCCESS) {
+			break;
+		}
+		self->retired_rules = next;
+	}
+}
+
+static void
+run (LV2_Handle instance, uint32_t n_samples)
+{
+	ReqVal*        self     = (ReqVal*)instance;
+	const uint32_t overruns = self->watchdog.n_overruns;
+
+	wd_begin (&self->watchdog);
+#ifdef REQVAL_TRACE
+	self->tracer.paused = self->watchdog.level >= WD_NO_TRACE;
+#endif
+
+	process_cycle (self, n_samples);
+
+	if (self->retired_curves || self->retired_rules) {
+		retire_flush (self);
+	}
+
+	/* the new level applies from the next cycle on, and is published with it */
+	if (wd_end (&self->watchdog, n_samples, self->sample_rate) || overruns != self->watchdog.n_overruns) {
+		self->status.load_level = self->watchdog.level;
+		self->status.n_overruns = self->watchdog.n_overruns;
+		self->status_dirty      = true;
+	}
+
+	if (self->exporter.running) {
+		publish_metrics (self, n_samples);
+	}
+}
+
+static void
+cleanup (LV2_Handle instance)
+{
+	ReqVal* self = (ReqVal*)instance;
+	metrics_stop (&self->exporter);
+	workthread_stop (&self->workthread);
+#ifdef REQVAL_TRACE
+	trace_cleanup (&self->tracer);
+#endif
+#ifdef DISPLAY_INTERFACE
+	if (self->display) {
+		cairo_surface_destroy (self->display);
+	}
+#endif
+	delayline_free (&self->delay);
+	while (self->retired_curves) {
+		ReqValCurve* c       = self->retired_curves;
+		self->retired_curves = c->retired;
+		free (c);
+	}
+	while (self->retired_rules) {
+		ReqValRules* r      = self->retired_rules;
+		self->retired_rules = r->retired;
+		free (r);
+	}
+	free (self->rules);
+	free (self->curve);
+	free (instance);
+}
+
+/* ****************************************************************************
+ * Worker, load/free transfer curves and rules off the realtime thread
+ */
+
+static ReqValCurve*
+load_curve (ReqVal* self, const char* path)
+{
+	FILE* f = fopen (path, "r");
+	if (!f) {
+		lv2_log_error (&self->logger, "ReqVal.lv2: Cannot open '%s'.\n", path);
+		return NULL;
+	}
+
+	uint32_t     n_alloc = 256;
+	ReqValCurve* curve   = (ReqValCurve*)malloc (sizeof (ReqValCurve) + n_alloc * sizeof (float));
+	if (!curve) {
+		fclose (f);
+		return NULL;
+	}
+	curve->n_points = 0;
+
+	float v;
+	while (curve && curve->n_points < MAX_CURVE_POINTS && 1 == fscanf (f, "%f", &v)) {
+		if (curve->n_points == n_alloc) {
+			n_alloc *= 2;
+			ReqValCurve* c = (ReqValCurve*)realloc (curve, sizeof (ReqValCurve) + n_alloc * sizeof (float));
+			if (!c) {
+				free (curve);
+			}
+			curve = c;
+			if (!curve) {
+				break;
+			}
+		}
+		curve->data[curve->n_points++] = isfinite (v) ? v : 0.f;
+	}
+	fclose (f);
+
+	if (!curve || curve->n_points < 2) {
+		lv2_log_error (&self->logger, "ReqVal.lv2: '%s' is not a valid transfer curve.\n", path);
+		free (curve);
+		return NULL;
+	}
+
+	lv2_log_note (&self->logger, "ReqVal.lv2: Loaded %d point curve '%s'.\n", curve->n_points, path);
+	return curve;
+}
+
+static ReqValRules*
+load_rules (ReqVal* self, const char* path)
+{
+	FILE* f = fopen (path, "r");
+	if (!f) {
+		lv2_log_error (&self->logger, "ReqVal.lv2: Cannot open '%s'.\n", path);
+		return NULL;
+	}
+
+	ReqValRules* rules = (ReqValRules*)calloc (1, sizeof (ReqValRules));
+
+	char     line[1024];
+	uint32_t lineno = 0;
+	while (rules && fgets (line, sizeof (line), f)) {
+		++lineno;
+		switch (rules_compile_line (rules, line, self->sample_rate, reqval_params, REQVAL_N_PARAMS, reqval_workflows, REQVAL_N_WORKFLOWS)) {
+			case -1:
+				lv2_log_error (&self->logger, "ReqVal.lv2: Syntax error in '%s' line %d.\n", path, lineno);
+				free (rules);
+				rules = NULL;
+				break;
+			case -2:
+				lv2_log_warning (&self->logger, "ReqVal.lv2: Too many rules in '%s', ignoring line %d.\n", path, lineno);
+				break;
+			default:
+				break;
+		}
+	}
+	fclose (f);
+
+	if (rules) {
+		lv2_log_note (&self->logger, "ReqVal.lv2: Loaded %d rules from '%s'.\n", rules->n_rules, path);
+	}
+	return rules;
+}
+
+/* the path of a ReqValLoadMsg of `size` bytes, NULL unless it is
+ * terminated within the message */
+static const char*
+load_path (const LV2_Atom* msg, uint32_t size)
+{
+	const char*    path = (const char*)LV2_ATOM_BODY_CONST (msg);
+	const uint32_t len  = size - sizeof (LV2_Atom);
+	if (msg->size == 0 || msg->size > len || !memchr (path, '\0', msg->size)) {
+		return NULL;
+	}
+	return path;
+}
+
+static LV2_Worker_Status
+work (LV2_Handle                  instance,
+      LV2_Worker_Respond_Function respond,
+      LV2_Worker_Respond_Handle   handle,
+      uint32_t                    size,
+      const void*                 data)
+{
+	ReqVal*         self = (ReqVal*)instance;
+	const LV2_Atom* msg  = (const LV2_Atom*)data;
+
+	if (size < sizeof (LV2_Atom)) {
+		return LV2_WORKER_ERR_UNKNOWN;
+	}
+
+	if (msg->type == self->uris.m_log) {
+		const ReqValLogMsg* m = (const ReqValLogMsg*)data;
+		lv2_log_printf (&self->logger, m->level, "%s", m->text);
+	} else if (msg->type == self->uris.m_curve_free) {
+		free (((const ReqValCurveMsg*)data)->curve);
+	} else if (msg->type == self->uris.m_rules_free) {
+		free (((const ReqValRulesMsg*)data)->rules);
+	} else if (msg->type == self->uris.m_rules_load) {
+		const char* path = load_path (msg, size);
+		ReqValRulesMsg r;
+		r.atom.type = self->uris.m_rules_apply;
+		r.atom.size = sizeof (ReqValRules*);
+		r.rules     = path ? load_rules (self, path) : NULL;
+		if (r.rules) {
+			respond (handle, sizeof (r), &r);
+		}
+	} else if (msg->type == self->uris.atom_Path) {
+		const char*    path = load_path (msg, size);
+		ReqValCurveMsg r;
+		r.atom.type  = self->uris.m_curve_apply;
+		r.atom.size  = sizeof (ReqValCurve*);
+		r.curve      = path ? load_curve (self, path) : NULL;
+		if (r.curve) {
+			respond (handle, sizeof (r), &r);
+		}
+	} else {
+		return LV2_WORKER_ERR_UNKNOWN;
+	}
+	return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status
+work_response (LV2_Handle  instance,
+               uint32_t    size,
+               const void* data)
+{
+	ReqVal*               self = (ReqVal*)instance;
+	const ReqValCurveMsg* msg  = (const ReqValCurveMsg*)data;
+
+	if (size == sizeof (ReqValRulesMsg) && msg->atom.type == self->uris.m_rules_apply) {
+		/* queued requests hold rendered messages, the old set can go */
+		if (self->rules) {
+			self->rules->retired = self->retired_rules;
+			self->retired_rules  = self->rules;
+		}
+		self->rules = ((const ReqValRulesMsg*)data)->rules;
+		retire_flush (self);
+		return LV2_WORKER_SUCCESS;
+	}
+
+	if (size != sizeof (ReqValCurveMsg) || msg->atom.type != self->uris.m_curve_apply) {
+		return LV2_WORKER_ERR_UNKNOWN;
+	}
+
+	/* called in the same context as run(), swap and pass the old one back to the worker */
+	if (self->curve) {
+		self->curve->retired = self->retired_curves;
+		self->retired_curves = self->curve;
+	}
+	self->curve = msg->curve;
+	retire_flush (self);
+	return LV2_WORKER_SUCCESS;
+}
+
+/* ****************************************************************************
+ * State, persist cached answers
+ */
+
+static bool
+cache_persistent (int param)
+{
+	return reqval_cache_ttl[param] != 0 && reqval_cache_ttl[param] != REQVAL_CACHE_SESSION;
+}
+
+static LV2_State_Status
+save (LV2_Handle                instance,
+      LV2_State_Store_Function  store,
+      LV2_State_Handle          handle,
+      uint32_t                  flags,
+      const LV2_Feature* const* features)
+{
+	ReqVal*     self = (ReqVal*)instance;
+	ReqValCache c;
+
+	/* may be called concurrently with run() */
+	seqlock_read (&self->cache_lock, &c, &self->cache_pub, sizeof (ReqValCache));
+
+	const int64_t now = time (NULL);
+
+	for (int i = 0; i < REQVAL_N_PARAMS; ++i) {
+		ReqValCacheEntry const* e = &c.entry[i];
+		if (!e->valid || !cache_persistent (i)) {
+			continue;
+		}
+
+		/* absolute wall-clock time, 0: never expires */
+		int64_t expires = 0;
+		if (e->expires != UINT64_MAX) {
+			if (e->expires <= c.now) {
+				continue;
+			}
+			expires = now + (int64_t)ceil ((e->expires - c.now) / self->sample_rate);
+		}
+
+		store (handle, self->cache_key[i], &e->value.body, sizeof (int32_t), e->value.atom.type,
+		       LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+		store (handle, self->cache_expires_key[i], &expires, sizeof (int64_t), self->uris.atom_Long,
+		       LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+	}
+	return LV2_STATE_SUCCESS;
+}
+
+static LV2_State_Status
+restore (LV2_Handle                  instance,
+         LV2_State_Retrieve_Function retrieve,
+         LV2_State_Handle            handle,
+         uint32_t                    flags,
+         const LV2_Feature* const*   features)
+{
+	ReqVal* self = (ReqVal*)instance;
+
+	const int64_t now = time (NULL);
+
+	for (int i = 0; i < REQVAL_N_PARAMS; ++i) {
+		ReqValCacheEntry* e = &self->cache.entry[i];
+		size_t            size;
+		uint32_t          type;
+		uint32_t          vflags;
+
+		if (!cache_persistent (i)) {
+			continue;
+		}
+
+		e->valid = false;
+
+		const void* value = retrieve (handle, self->cache_key[i], &size, &type, &vflags);
+		if (!value || size != sizeof (int32_t) || type != self->rvc.params[i].type) {
+			continue;
+		}
+
+		e->expires = UINT64_MAX;
+
+		const void* expires = retrieve (handle, self->cache_expires_key[i], &size, &type, &vflags);
+		if (expires && size == sizeof (int64_t) && type == self->uris.atom_Long) {
+			int64_t t;
+			memcpy (&t, expires, sizeof (int64_t));
+			if (t != 0 && t <= now) {
+				continue;
+			}
+			if (t != 0) {
+				e->expires = self->sample_cnt + (uint64_t)(t - now) * self->sample_rate;
+			}
+		}
+
+		e->value.atom.type = type;
+		e->value.atom.size = sizeof (int32_t);
+		memcpy (&e->value.body, value, sizeof (int32_t));
+		e->valid = true;
+	}
+
+	/* not called concurrently with run() */
+	self->cache.now = self->sample_cnt;
+	seqlock_write_begin (&self->cache_lock);
+	self->cache_pub = self->cache;
+	seqlock_write_end (&self->cache_lock);
+
+	return LV2_STATE_SUCCESS;
+}
+
+#ifdef DISPLAY_INTERFACE
+/* ****************************************************************************
+ * Inline Display
+ */
+
+static void
+display_text (cairo_t* cr, double x, double y, const char* txt)
+{
+	cairo_move_to (cr, x, y);
+	cairo_show_text (cr, txt);
+}
+
+static LV2_Inline_Display_Image_Surface*
+render_inline (LV2_Handle instance, uint32_t w, uint32_t max_h)
+{
+	ReqVal*  self = (ReqVal*)instance;
+	uint32_t h    = max_h > 40 ? 40 : max_h;
+
+	/* re-render only if new state was published or the size changed */
+	if (self->display && self->w == w && self->h == h && self->display_gen == seqlock_generation (&self->status_lock)) {
+		return &self->surf;
+	}
+
+	ReqValStatus st;
+	self->display_gen = seqlock_read (&self->status_lock, &st, &self->status_pub, sizeof (ReqValStatus));
+
+	if (!self->display || self->w != w || self->h != h) {
+		if (self->display) {
+			cairo_surface_destroy (self->display);
+		}
+		self->display = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
+		self->w       = w;
+		self->h       = h;
+	}
+
+	cairo_t* cr = cairo_create (self->display);
+
+	if (st.pending) {
+		cairo_set_source_rgb (cr, .6, .4, .0);
+	} else if (st.have_answer) {
+		cairo_set_source_rgb (cr, .0, .3, .1);
+	} else {
+		cairo_set_source_rgb (cr, .2, .2, .2);
+	}
+	cairo_paint (cr);
+
+	char txt[64];
+	cairo_set_source_rgb (cr, .9, .9, .9);
+	cairo_set_font_size (cr, h / 3.5);
+
+	if (st.pending) {
+		snprintf (txt, sizeof (txt), "Pending (%u)", st.n_requests);
+	} else if (st.have_answer) {
+		snprintf (txt, sizeof (txt), "Answer: %s", st.last_answer ? "yes" : "no");
+	} else {
+		snprintf (txt, sizeof (txt), "Idle");
+	}
+	display_text (cr, 4, h * .4, txt);
+
+	if (st.n_answers > 0) {
+		snprintf (txt, sizeof (txt), "Latency: %.1fs", st.latency);
+		display_text (cr, 4, h * .85, txt);
+	}
+
+	cairo_destroy (cr);
+	cairo_surface_flush (self->display);
+
+	self->surf.width  = cairo_image_surface_get_width (self->display);
+	self->surf.height = cairo_image_surface_get_height (self->display);
+	self->surf.stride = cairo_image_surface_get_stride (self->display);
+	self->surf.data   = cairo_image_surface_get_data (self->display);
+
+	return &self->surf;
+}
+#endif
+
+static const void*
+extension_data (const char* uri)
+{
+	static const LV2_Worker_Interface worker = { work, work_response, NULL };
+	static const LV2_State_Interface  state  = { save, restore };
+#ifdef DISPLAY_INTERFACE
+	static const LV2_Inline_Display_Interface display = { render_inline };
+	if (!strcmp (uri, LV2_INLINEDISPLAY__interface)) {
+		return &display;
+	}
+#endif
+	if (!strcmp (uri, LV2_WORKER__interface)) {
+		return &worker;
+	}
+	if (!strcmp (uri, LV2_STATE__interface)) {
+		return &state;
+	}
 	return NULL;
 }
 
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Minimal X11 UI, displays the request state and allows to set
+ * the boolean parameter. Communication with the DSP is exclusively
+ * via atom messages; the DSP coalesces state updates, and the UI
+ * batches parameter changes, sending at most one patch:Set per
+ * property each idle-callback (GUI frame).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
+#include <lv2/lv2plug.in/ns/ext/patch/patch.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/extensions/ui/ui.h>
+
+/* after LV2 headers, Xlib #defines Bool */
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#define REQVAL_NO_PARAM_TABLE
+#include "parameters.h"
+#include "uris.h"
+
+#define REQVAL_UI_URI REQVAL_URI "#ui"
+
+#define UI_WIDTH 240
+#define UI_HEIGHT 108
+
+typedef struct {
+	LV2_URID atom_Bool;
+	LV2_URID atom_Int;
+	LV2_URID atom_Float;
+	LV2_URID atom_Object;
+	LV2_URID atom_eventTransfer;
+	LV2_URID patch_Set;
+	LV2_URID patch_property;
+	LV2_URID patch_value;
+	LV2_URID m_bool_test;
+	LV2_URID m_ui_on;
+	LV2_URID m_ui_off;
+	LV2_URID m_state;
+	LV2_URID m_n_requests;
+	LV2_URID m_n_answers;
+	LV2_URID m_pending;
+	LV2_URID m_have_answer;
+	LV2_URID m_last_answer;
+	LV2_URID m_latency;
+	LV2_URID m_n_clamped;
+	LV2_URID m_n_rejected;
+	LV2_URID m_load_level;
+	LV2_URID m_n_overruns;
+} ReqValUIURIs;
+
+typedef struct {
+	LV2UI_Write_Function write;
+	LV2UI_Controller     controller;
+
+	LV2_Atom_Forge forge;
+	ReqValUIURIs   uris;
+
+	Display* dpy;
+	Window   win;
+	GC       gc;
+	bool     toplevel;
+	bool     redraw;
+
+	/* state received from the DSP */
+	int32_t n_requests;
+	int32_t n_answers;
+	bool    pending;
+	bool    have_answer;
+	bool    last_answer;
+	float   latency;
+	int32_t n_clamped;
+	int32_t n_rejected;
+	int32_t load_level;
+	int32_t n_overruns;
+
+	/* queued parameter changes, flushed once per frame */
+	bool bool_test;
+	bool bool_test_dirty;
+} ReqValUI;
+
+static void
+map_uris (LV2_URID_Map* map, ReqValUIURIs* uris)
+{
+	uris->atom_Bool          = map->map (map->handle, LV2_ATOM__Bool);
+	uris->atom_Int           = map->map (map->handle, LV2_ATOM__Int);
+	uris->atom_Float         = map->map (map->handle, LV2_ATOM__Float);
+	uris->atom_Object        = map->map (map->handle, LV2_ATOM__Object);
+	uris->atom_eventTransfer = map->map (map->handle, LV2_ATOM__eventTransfer);
+	uris->patch_Set          = map->map (map->handle, LV2_PATCH__Set);
+	uris->patch_property     = map->map (map->handle, LV2_PATCH__property);
+	uris->patch_value        = map->map (map->handle, LV2_PATCH__value);
+	uris->m_bool_test        = map->map (map->handle, REQVAL__booltest);
+	uris->m_ui_on            = map->map (map->handle, REQVAL__ui_on);
+	uris->m_ui_off           = map->map (map->handle, REQVAL__ui_off);
+	uris->m_state            = map->map (map->handle, REQVAL__state);
+	uris->m_n_requests       = map->map (map->handle, REQVAL__n_requests);
+	uris->m_n_answers        = map->map (map->handle, REQVAL__n_answers);
+	uris->m_pending          = map->map (map->handle, REQVAL__pending);
+	uris->m_have_answer      = map->map (map->handle, REQVAL__have_answer);
+	uris->m_last_answer      = map->map (map->handle, REQVAL__last_answer);
+	uris->m_latency          = map->map (map->handle, REQVAL__latency);
+	uris->m_n_clamped        = map->map (map->handle, REQVAL__n_clamped);
+	uris->m_n_rejected       = map->map (map->handle, REQVAL__n_rejected);
+	uris->m_load_level       = map->map (map->handle, REQVAL__load_level);
+	uris->m_n_overruns       = map->map (map->handle, REQVAL__n_overruns);
+}
+
+/* ****************************************************************************
+ * DSP communication
+ */
+
+static void
+tx_message (ReqValUI* ui, LV2_URID otype)
+{
+	uint8_t              buf[64];
+	LV2_Atom_Forge_Frame frame;
+
+	lv2_atom_forge_set_buffer (&ui->forge, buf, sizeof (buf));
+	LV2_Atom* msg = (LV2_Atom*)lv2_atom_forge_object (&ui->forge, &frame, 1, otype);
+	lv2_atom_forge_pop (&ui->forge, &frame);
+
+	ui->write (ui->controller, REQVAL_CONTROL, lv2_atom_total_size (msg), ui->uris.atom_eventTransfer, msg);
+}
+
+static void
+tx_bool (ReqValUI* ui, LV2_URID property, bool value)
+{
+	uint8_t              buf[128];
+	LV2_Atom_Forge_Frame frame;
+
+	lv2_atom_forge_set_buffer (&ui->forge, buf, sizeof (buf));
+	LV2_Atom* msg = (LV2_Atom*)lv2_atom_forge_object (&ui->forge, &frame, 1, ui->uris.patch_Set);
+	lv2_atom_forge_key (&ui->forge, ui->uris.patch_property);
+	lv2_atom_forge_urid (&ui->forge, property);
+	lv2_atom_forge_key (&ui->forge, ui->uris.patch_value);
+	lv2_atom_forge_bool (&ui->forge, value);
+	lv2_atom_forge_pop (&ui->forge, &frame);
+
+	ui->write (ui->controller, REQVAL_CONTROL, lv2_atom_total_size (msg), ui->uris.atom_eventTransfer, msg);
+}
+
+static void
+flush_writes (ReqValUI* ui)
+{
+	if (ui->bool_test_dirty) {
+		ui->bool_test_dirty = false;
+		tx_bool (ui, ui->uris.m_bool_test, ui->bool_test);
+	}
+}
+
+static void
+rx_state (ReqValUI* ui, const LV2_Atom_Object* obj)
+{
+	const LV2_Atom* n_requests  = NULL;
+	const LV2_Atom* n_answers   = NULL;
+	const LV2_Atom* pending     = NULL;
+	const LV2_Atom* have_answer = NULL;
+	const LV2_Atom* last_answer = NULL;
+	const LV2_Atom* latency     = NULL;
+	const LV2_Atom* n_clamped   = NULL;
+	const LV2_Atom* n_rejected  = NULL;
+	const LV2_Atom* load_level  = NULL;
+	const LV2_Atom* n_overruns  = NULL;
+
+	lv2_atom_object_get (obj,
+	                     ui->uris.m_n_requests, &n_requests,
+	                     ui->uris.m_n_answers, &n_answers,
+	                     ui->uris.m_pending, &pending,
+	                     ui->uris.m_have_answer, &have_answer,
+	                     ui->uris.m_last_answer, &last_answer,
+	                     ui->uris.m_latency, &latency,
+	                     ui->uris.m_n_clamped, &n_clamped,
+	                     ui->uris.m_n_rejected, &n_rejected,
+	                     ui->uris.m_load_level, &load_level,
+	                     ui->uris.m_n_overruns, &n_overruns,
+	                     0);
+
+	if (n_requests && n_requests->type == ui->uris.atom_Int) {
+		ui->n_requests = ((const LV2_Atom_Int*)n_requests)->body;
+	}
+	if (n_answers && n_answers->type == ui->uris.atom_Int) {
+		ui->n_answers = ((const LV2_Atom_Int*)n_answers)->body;
+	}
+	if (pending && pending->type == ui->uris.atom_Bool) {
+		ui->pending = ((const LV2_Atom_Bool*)pending)->body;
+	}
+	if (have_answer && have_answer->type == ui->uris.atom_Bool) {
+		ui->have_answer = ((const LV2_Atom_Bool*)have_answer)->body;
+	}
+	if (last_answer && last_answer->type == ui->uris.atom_Bool) {
+		ui->last_answer = ((const LV2_Atom_Bool*)last_answer)->body;
+		ui->bool_test   = ui->last_answer;
+	}
+	if (latency && latency->type == ui->uris.atom_Float) {
+		ui->latency = ((const LV2_Atom_Float*)latency)->body;
+	}
+	if (n_clamped && n_clamped->type == ui->uris.atom_Int) {
+		ui->n_clamped = ((const LV2_Atom_Int*)n_clamped)->body;
+	}
+	if (n_rejected && n_rejected->type == ui->uris.atom_Int) {
+		ui->n_rejected = ((const LV2_Atom_Int*)n_rejected)->body;
+	}
+	if (load_level && load_level->type == ui->uris.atom_Int) {
+		ui->load_level = ((const LV2_Atom_Int*)load_level)->body;
+	}
+	if (n_overruns && n_overruns->type == ui->uris.atom_Int) {
+		ui->n_overruns = ((const LV2_Atom_Int*)n_overruns)->body;
+	}
+	ui->redraw = true;
+}
+
+/* ****************************************************************************
+ * X11
+ */
+
+static void
+draw (ReqValUI* ui)
+{
+	char txt[64];
+
+	XSetForeground (ui->dpy, ui->gc, ui->pending ? 0x996600 : (ui->have_answer ? 0x004d1a : 0x333333));
+	XFillRectangle (ui->dpy, ui->win, ui->gc, 0, 0, UI_WIDTH, UI_HEIGHT);
+	XSetForeground (ui->dpy, ui->gc, 0xe6e6e6);
+
+	if (ui->pending) {
+		snprintf (txt, sizeof (txt), "Pending (%d)", ui->n_requests);
+	} else if (ui->have_answer) {
+		snprintf (txt, sizeof (txt), "Answer: %s, latency %.1fs", ui->last_answer ? "yes" : "no", ui->latency);
+	} else {
+		snprintf (txt, sizeof (txt), "Idle");
+	}
+	XDrawString (ui->dpy, ui->win, ui->gc, 8, 20, txt, strlen (txt));
+
+	snprintf (txt, sizeof (txt), "Bool: %s (click to toggle)", ui->bool_test ? "on" : "off");
+	XDrawString (ui->dpy, ui->win, ui->gc, 8, 44, txt, strlen (txt));
+
+	snprintf (txt, sizeof (txt), "Clamped: %d, rejected: %d", ui->n_clamped, ui->n_rejected);
+	XDrawString (ui->dpy, ui->win, ui->gc, 8, 68, txt, strlen (txt));
+
+	snprintf (txt, sizeof (txt), "Load level: %d, overruns: %d", ui->load_level, ui->n_overruns);
+	XDrawString (ui->dpy, ui->win, ui->gc, 8, 92, txt, strlen (txt));
+
+	XFlush (ui->dpy);
+	ui->redraw = false;
+}
+
+static int
+idle (LV2UI_Handle handle)
+{
+	ReqValUI* ui = (ReqValUI*)handle;
+
+	while (XPending (ui->dpy) > 0) {
+		XEvent ev;
+		XNextEvent (ui->dpy, &ev);
+		switch (ev.type) {
+			case Expose:
+				ui->redraw = true;
+				break;
+			case ButtonPress:
+				if (ev.xbutton.button == Button1) {
+					ui->bool_test       = !ui->bool_test;
+					ui->bool_test_dirty = true;
+					ui->redraw          = true;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	flush_writes (ui);
+
+	if (ui->redraw) {
+		draw (ui);
+	}
+	return 0;
+}
+
+/* ****************************************************************************
+ * LV2 UI
+ */
+
+static LV2UI_Handle
+instantiate (const LV2UI_Descriptor*   descriptor,
+             const char*               plugin_uri,
+             const char*               bundle_path,
+             LV2UI_Write_Function      write_function,
+             LV2UI_Controller          controller,
+             LV2UI_Widget*             widget,
+             const LV2_Feature* const* features)
+{
+	LV2_URID_Map* map    = NULL;
+	Window        parent = 0;
+
+	if (strcmp (plugin_uri, REQVAL_URI)) {
+		return NULL;
+	}
+
+	for (int i = 0; features[i]; ++i) {
+		if (!strcmp (features[i]->URI, LV2_URID__map)) {
+			map = (LV2_URID_Map*)features[i]->data;
+		} else if (!strcmp (features[i]->URI, LV2_UI__parent)) {
+			parent = (Window)(uintptr_t)features[i]->data;
+		}
+	}
+
+	if (!map) {
+		fprintf (stderr, "ReqVal.lv2 UI: Host does not support urid:map\n");
+		return NULL;
+	}
+
+	ReqValUI* ui = (ReqValUI*)calloc (1, sizeof (ReqValUI));
+	if (!ui) {
+		return NULL;
+	}
+
+	ui->dpy = XOpenDisplay (NULL);
+	if (!ui->dpy) {
+		fprintf (stderr, "ReqVal.lv2 UI: Cannot open X11 display\n");
+		free (ui);
+		return NULL;
+	}
+
+	ui->write      = write_function;
+	ui->controller = controller;
+
+	map_uris (map, &ui->uris);
+	lv2_atom_forge_init (&ui->forge, map);
+
+	ui->toplevel = parent == 0;
+	if (ui->toplevel) {
+		parent = DefaultRootWindow (ui->dpy);
+	}
+
+	ui->win = XCreateSimpleWindow (ui->dpy, parent, 0, 0, UI_WIDTH, UI_HEIGHT, 0, 0, 0x333333);
+	ui->gc  = XCreateGC (ui->dpy, ui->win, 0, NULL);
+	XSelectInput (ui->dpy, ui->win, ExposureMask | ButtonPressMask);
+
+	if (ui->toplevel) {
+		XStoreName (ui->dpy, ui->win, "Request Value Test");
+	}
+	XMapRaised (ui->dpy, ui->win);
+	XFlush (ui->dpy);
+
+	*widget    = (LV2UI_Widget)(uintptr_t)ui->win;
+	ui->redraw = true;
+
+	/* ask the DSP for state updates */
+	tx_message (ui, ui->uris.m_ui_on);
+	return ui;
+}
+
+static void
+cleanup (LV2UI_Handle handle)
+{
+	ReqValUI* ui = (ReqValUI*)handle;
+	tx_message (ui, ui->uris.m_ui_off);
+	XFreeGC (ui->dpy, ui->gc);
+	XDestroyWindow (ui->dpy, ui->win);
+	XCloseDisplay (ui->dpy);
+	free (ui);
+}
+
+static void
+port_event (LV2UI_Handle handle,
+            uint32_t     port_index,
+            uint32_t     buffer_size,
+            uint32_t     format,
+            const void*  buffer)
+{
+	ReqValUI*       ui   = (ReqValUI*)handle;
+	const LV2_Atom* atom = (const LV2_Atom*)buffer;
+
+	if (port_index != REQVAL_NOTIFY || format != ui->uris.atom_eventTransfer) {
+		return;
+	}
+	if (atom->type != ui->uris.atom_Object) {
+		return;
+	}
+
+	const LV2_Atom_Object* obj = (const LV2_Atom_Object*)atom;
+	if (obj->body.otype == ui->uris.m_state) {
+		rx_state (ui, obj);
+	}
+}
+
+static const void*
+extension_data (const char* uri)
+{
+	static const LV2UI_Idle_Interface idle_iface = { idle };
+	if (!strcmp (uri, LV2_UI__idleInterface)) {
+		return &idle_iface;
+	}
+	return NULL;
+}
+
+static const LV2UI_Descriptor descriptor = {
+	REQVAL_UI_URI,
+	instantiate,
+	cleanup,
+	port_event,
+	extension_data
+};
+
+/* clang-format off */
+#undef LV2_SYMBOL_EXPORT
+#ifdef _WIN32
+# define LV2_SYMBOL_EXPORT __declspec(dllexport)
+#else
+# define LV2_SYMBOL_EXPORT __attribute__ ((visibility ("default")))
+#endif
+/* clang-format on */
+LV2_SYMBOL_EXPORT
+const LV2UI_Descriptor*
+lv2ui_descriptor (uint32_t index)
+{
+	switch (index) {
+		case 0:
+			return &descriptor;
+		default:
+			return NULL;
+	}
+}
@@ -0,0 +1,537 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_CLIENT_H
+#define REQVAL_CLIENT_H
+
+/* Header-only helper for plugins using ui:requestValue
+ *
+ *  - rvc_init ()     scan host features, map URIDs
+ *  - rvc_register () add a patch:writable parameter, returns its index
+ *  - rvc_register_table () add parameters from a constant table,
+ *                    the table index is the parameter index
+ *  - rvc_find_symbol () look up a parameter in a table by symbol
+ *  - rvc_decode ()   decode a patch:Set to a parameter index + value
+ *  - rvc_store ()    validate and store a decoded value according to its spec
+ *  - rvc_enqueue ()  queue a request-value dialog for a parameter
+ *  - rvc_enqueue_prio () same, with a priority class
+ *  - rvc_enqueue_msg () same, returns the buffer to write the message to
+ *  - rvc_issue ()    call once per run(), issues the next queued request
+ *                    critical first, then normal and background
+ *                    requests weighted RVC_WEIGHT_NORMAL : 1
+ *
+ * All functions but rvc_init and rvc_register* are realtime-safe.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
+#include <lv2/lv2plug.in/ns/ext/patch/patch.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/extensions/ui/ui.h>
+#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
+
+/* custom extension */
+#define LV2_DIALOGMESSAGE_URI "http://ardour.org/lv2/dialog_message"
+
+typedef struct {
+  void (*free_msg)(char const* msg);
+
+  char const* msg;
+  bool requires_return;
+
+} LV2_Dialog_Message;
+
+#ifndef RVC_MAX_PARAMS
+#define RVC_MAX_PARAMS 16
+#endif
+
+#ifndef RVC_MAX_QUEUE
+#define RVC_MAX_QUEUE 16 // power of two, per priority class
+#endif
+
+#ifndef RVC_MSG_LEN
+#define RVC_MSG_LEN 192 // per queued request, including the terminating zero
+#endif
+
+#ifndef RVC_WEIGHT_NORMAL
+#define RVC_WEIGHT_NORMAL 4 // normal requests issued per background request
+#endif
+
+typedef enum {
+	RVC_OK            =  0,
+	RVC_ERR_NO_BODY   = -1, // patch:Set without property
+	RVC_ERR_NOT_URID  = -2, // property is not a URID
+	RVC_ERR_NO_VALUE  = -3, // patch:Set without value
+	RVC_ERR_UNKNOWN   = -4, // property was not registered
+	RVC_ERR_TYPE      = -5, // value type does not match registered type
+	RVC_ERR_NOSPACE   = -6, // too many parameters or queued requests
+	RVC_ERR_REJECTED  = -7, // host rejected the request
+	RVC_NONE          = -8, // nothing to do
+	RVC_ERR_RANGE     = -9, // value not allowed (non-finite, not in enumeration)
+	RVC_CLAMPED       =  1, // value was stored, but clamped to min/max
+} RVC_Status;
+
+typedef enum {
+	RVC_BOOL = 0,
+	RVC_INT,
+	RVC_FLOAT,
+	RVC_PATH,
+} RVC_Kind;
+
+/* constant parameter description, see src/parameters.spec
+ * minimum/maximum is -FLT_MAX/FLT_MAX if unconstrained, so that
+ * clamping is unconditional.
+ */
+typedef struct {
+	const char*  uri;
+	RVC_Kind     kind;
+	float        minimum;
+	float        maximum;
+	float        dflt;
+	int32_t      offset; // byte offset in value storage, -1 if not stored
+	float const* enum_values;
+	uint32_t     n_enum;
+} RVC_ParamSpec;
+
+typedef enum {
+	RVC_PRIO_CRITICAL = 0, // always issued first
+	RVC_PRIO_NORMAL,
+	RVC_PRIO_BACKGROUND,
+	RVC_N_PRIO
+} RVC_Priority;
+
+typedef struct {
+	LV2_URID property;
+	LV2_URID type;
+	RVC_Kind kind;
+} RVC_Param;
+
+/* a queue slot owns its message. A host that announced
+ * LV2_DIALOGMESSAGE_URI may use it until it calls
+ * LV2_Dialog_Message.free_msg, after the request was issued */
+typedef struct {
+	int32_t param;
+	bool    requires_return;
+	bool    held; // issued, the host has not freed the message yet
+	char    msg[RVC_MSG_LEN];
+} RVC_Request;
+
+typedef struct {
+	/* host features */
+	LV2_URID_Map*        map;
+	LV2UI_Request_Value* request_value;
+
+	/* the host passed LV2_DIALOGMESSAGE_URI to instantiate, and calls
+	 * free_msg for every message it was given. Otherwise it does not
+	 * keep messages, and the slot of an issued request can be reused
+	 * right away */
+	bool host_frees;
+
+	/* features passed with each request */
+	LV2_Feature        dialog_feature;
+	LV2_Dialog_Message dialog_message;
+	const LV2_Feature* features[2];
+
+	/* URIDs */
+	LV2_URID atom_Object;
+	LV2_URID atom_URID;
+	LV2_URID kind_type[RVC_PATH + 1];
+	LV2_URID patch_Set;
+	LV2_URID patch_property;
+	LV2_URID patch_value;
+
+	/* registered parameters */
+	RVC_Param params[RVC_MAX_PARAMS];
+	uint32_t  n_params;
+
+	/* request queues, one per priority class, single threaded (run) */
+	RVC_Request queue[RVC_N_PRIO][RVC_MAX_QUEUE];
+	uint32_t    q_head[RVC_N_PRIO];
+	uint32_t    q_tail[RVC_N_PRIO];
+
+	/* smooth weighted round-robin state, normal vs background */
+	int32_t wrr[RVC_N_PRIO];
+	int     pending_prio; // class selected for the next issue, -1: none
+
+	/* the request last passed to the host, -1: none. Whether it
+	 * expects a reply is in dialog_message.requires_return */
+	int32_t last_param;
+} RVC_Client;
+
+/* called by the host from any thread, once it no longer uses a message */
+static inline void
+rvc_free_msg (char const* msg)
+{
+	RVC_Request* r = (RVC_Request*)(msg - offsetof (RVC_Request, msg));
+	__atomic_store_n (&r->held, false, __ATOMIC_RELEASE);
+}
+
+/* scan host-features, returns false if urid:map or ui:requestValue is missing */
+static inline bool
+rvc_init (RVC_Client* c, const LV2_Feature* const* features)
+{
+	memset (c, 0, sizeof (RVC_Client));
+	c->pending_prio = -1;
+	c->last_param   = -1;
+
+	for (int i = 0; features[i]; ++i) {
+		if (!strcmp (features[i]->URI, LV2_URID__map)) {
+			c->map = (LV2_URID_Map*)features[i]->data;
+		} else if (!strcmp (features[i]->URI, LV2_UI__requestValue)) {
+			c->request_value = (LV2UI_Request_Value*)features[i]->data;
+		} else if (!strcmp (features[i]->URI, LV2_DIALOGMESSAGE_URI)) {
+			c->host_frees = true;
+		}
+	}
+
+	if (!c->map || !c->request_value) {
+		return false;
+	}
+
+	LV2_URID_Map* map = c->map;
+	c->atom_Object    = map->map (map->handle, LV2_ATOM__Object);
+	c->atom_URID      = map->map (map->handle, LV2_ATOM__URID);
+	c->patch_Set      = map->map (map->handle, LV2_PATCH__Set);
+	c->patch_property = map->map (map->handle, LV2_PATCH__property);
+	c->patch_value    = map->map (map->handle, LV2_PATCH__value);
+
+	c->kind_type[RVC_BOOL]  = map->map (map->handle, LV2_ATOM__Bool);
+	c->kind_type[RVC_INT]   = map->map (map->handle, LV2_ATOM__Int);
+	c->kind_type[RVC_FLOAT] = map->map (map->handle, LV2_ATOM__Float);
+	c->kind_type[RVC_PATH]  = map->map (map->handle, LV2_ATOM__Path);
+
+	c->dialog_message.msg             = NULL;
+	c->dialog_message.requires_return = true;
+	c->dialog_message.free_msg        = rvc_free_msg;
+
+	c->dialog_feature.URI  = LV2_DIALOGMESSAGE_URI;
+	c->dialog_feature.data = &c->dialog_message;
+
+	c->features[0] = &c->dialog_feature;
+	c->features[1] = NULL;
+	return true;
+}
+
+/* register a parameter, returns its index (>= 0) or RVC_ERR_NOSPACE */
+static inline int
+rvc_register (RVC_Client* c, const char* uri, RVC_Kind kind)
+{
+	if (c->n_params >= RVC_MAX_PARAMS) {
+		return RVC_ERR_NOSPACE;
+	}
+	RVC_Param* p = &c->params[c->n_params];
+	p->property  = c->map->map (c->map->handle, uri);
+	p->type      = c->kind_type[kind];
+	p->kind      = kind;
+	return c->n_params++;
+}
+
+/* register all parameters of a table, in order. Must be called
+ * before any other rvc_register, so that indices match the table.
+ */
+static inline bool
+rvc_register_table (RVC_Client* c, RVC_ParamSpec const* spec, uint32_t n_params)
+{
+	if (c->n_params != 0 || n_params > RVC_MAX_PARAMS) {
+		return false;
+	}
+	for (uint32_t i = 0; i < n_params; ++i) {
+		rvc_register (c, spec[i].uri, spec[i].kind);
+	}
+	return true;
+}
+
+static inline bool
+rvc_in_enum (RVC_ParamSpec const* spec, float v)
+{
+	for (uint32_t i = 0; i < spec->n_enum; ++i) {
+		if (spec->enum_values[i] == v) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* returns the index of the parameter with the given symbol, the URI
+ * fragment, in a constant table, or RVC_ERR_UNKNOWN */
+static inline int
+rvc_find_symbol (RVC_ParamSpec const* spec, uint32_t n_params, const char* sym)
+{
+	for (uint32_t i = 0; i < n_params; ++i) {
+		const char* s = strrchr (spec[i].uri, '#');
+		if (s && !strcmp (s + 1, sym)) {
+			return i;
+		}
+	}
+	return RVC_ERR_UNKNOWN;
+}
+
+/* validate and store a value returned by rvc_decode ().
+ * returns RVC_OK, RVC_CLAMPED (value was limited to minimum/maximum),
+ * RVC_ERR_RANGE (value was not stored) or RVC_NONE (no storage, e.g. paths).
+ */
+static inline int
+rvc_store (RVC_ParamSpec const* spec, const LV2_Atom* val, void* storage)
+{
+	if (spec->offset < 0) {
+		return RVC_NONE;
+	}
+
+	uint8_t* dst = (uint8_t*)storage + spec->offset;
+
+	switch (spec->kind) {
+		case RVC_BOOL:
+			*(bool*)dst = ((const LV2_Atom_Bool*)val)->body != 0;
+			return RVC_OK;
+		case RVC_INT: {
+			const int32_t v  = ((const LV2_Atom_Int*)val)->body;
+			const int32_t lo = spec->minimum <= INT32_MIN ? INT32_MIN : (int32_t)spec->minimum;
+			const int32_t hi = spec->maximum >= INT32_MAX ? INT32_MAX : (int32_t)spec->maximum;
+			if (spec->n_enum > 0 && !rvc_in_enum (spec, v)) {
+				return RVC_ERR_RANGE;
+			}
+			const int32_t c = v < lo ? lo : (v > hi ? hi : v);
+			*(int32_t*)dst  = c;
+			return c != v ? RVC_CLAMPED : RVC_OK;
+		}
+		case RVC_FLOAT: {
+			const float v = ((const LV2_Atom_Float*)val)->body;
+			if (!isfinite (v) || (spec->n_enum > 0 && !rvc_in_enum (spec, v))) {
+				return RVC_ERR_RANGE;
+			}
+			const float c = fminf (fmaxf (v, spec->minimum), spec->maximum);
+			*(float*)dst  = c;
+			return c != v ? RVC_CLAMPED : RVC_OK;
+		}
+		default:
+			return RVC_NONE;
+	}
+}
+
+static inline LV2_URID
+rvc_property (RVC_Client const* c, int param)
+{
+	return c->params[param].property;
+}
+
+/* returns the index of the parameter with the given property, or RVC_ERR_UNKNOWN */
+static inline int
+rvc_find (RVC_Client const* c, LV2_URID property)
+{
+	for (uint32_t i = 0; i < c->n_params; ++i) {
+		if (c->params[i].property == property) {
+			return i;
+		}
+	}
+	return RVC_ERR_UNKNOWN;
+}
+
+/* decode a patch:Set object.
+ * returns the parameter index (>= 0) and sets `value`, or an RVC_Status error.
+ */
+static inline int
+rvc_decode (RVC_Client const* c, const LV2_Atom_Object* obj, const LV2_Atom** value)
+{
+	const LV2_Atom* property = NULL;
+	const LV2_Atom* val      = NULL;
+
+	lv2_atom_object_get (obj, c->patch_property, &property, c->patch_value, &val, 0);
+
+	if (!property) {
+		return RVC_ERR_NO_BODY;
+	}
+	if (property->type != c->atom_URID) {
+		return RVC_ERR_NOT_URID;
+	}
+	if (!val) {
+		return RVC_ERR_NO_VALUE;
+	}
+
+	const int i = rvc_find (c, ((const LV2_Atom_URID*)property)->body);
+	if (i < 0) {
+		return i;
+	}
+	if (c->params[i].type != val->type) {
+		return RVC_ERR_TYPE;
+	}
+	*value = val;
+	return i;
+}
+
+/* true if a request of the given class can be queued: the queue is
+ * not full, and the host does not use the message of the slot */
+static inline bool
+rvc_can_enqueue (RVC_Client const* c, RVC_Priority prio)
+{
+	if (c->q_tail[prio] - c->q_head[prio] >= RVC_MAX_QUEUE) {
+		return false;
+	}
+	RVC_Request const* r = &c->queue[prio][c->q_tail[prio] & (RVC_MAX_QUEUE - 1)];
+	return !__atomic_load_n (&r->held, __ATOMIC_ACQUIRE);
+}
+
+/* queue a request with an empty message. Returns the message buffer of
+ * RVC_MSG_LEN bytes, to be filled in before the next rvc_issue (),
+ * or NULL if the parameter is unknown or the request cannot be queued */
+static inline char*
+rvc_enqueue_msg (RVC_Client* c, RVC_Priority prio, int param, bool requires_return)
+{
+	if (param < 0 || (uint32_t)param >= c->n_params || !rvc_can_enqueue (c, prio)) {
+		return NULL;
+	}
+	RVC_Request* r     = &c->queue[prio][c->q_tail[prio] & (RVC_MAX_QUEUE - 1)];
+	r->param           = param;
+	r->requires_return = requires_return;
+	r->held            = false;
+	r->msg[0]          = '\0';
+	++c->q_tail[prio];
+	return r->msg;
+}
+
+/* queue a request, `msg` is copied and truncated to RVC_MSG_LEN - 1 bytes */
+static inline RVC_Status
+rvc_enqueue_prio (RVC_Client* c, RVC_Priority prio, int param, char const* msg, bool requires_return)
+{
+	if (param < 0 || (uint32_t)param >= c->n_params) {
+		return RVC_ERR_UNKNOWN;
+	}
+	char* buf = rvc_enqueue_msg (c, prio, param, requires_return);
+	if (!buf) {
+		return RVC_ERR_NOSPACE;
+	}
+	if (msg) {
+		size_t len = strlen (msg);
+		if (len > RVC_MSG_LEN - 1) {
+			len = RVC_MSG_LEN - 1;
+		}
+		memcpy (buf, msg, len);
+		buf[len] = '\0';
+	}
+	return RVC_OK;
+}
+
+static inline RVC_Status
+rvc_enqueue (RVC_Client* c, int param, char const* msg, bool requires_return)
+{
+	return rvc_enqueue_prio (c, RVC_PRIO_NORMAL, param, msg, requires_return);
+}
+
+static inline uint32_t
+rvc_queued_prio (RVC_Client const* c, RVC_Priority prio)
+{
+	return c->q_tail[prio] - c->q_head[prio];
+}
+
+static inline bool
+rvc_queued (RVC_Client const* c)
+{
+	for (int p = 0; p < RVC_N_PRIO; ++p) {
+		if (c->q_tail[p] != c->q_head[p]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* select the class to issue from. Critical requests are strictly
+ * preferred. Normal and background share the remaining slots using
+ * smooth weighted round-robin, so background requests are never
+ * starved, but only get 1 / (RVC_WEIGHT_NORMAL + 1) of the slots
+ * when both are queued.
+ */
+static inline int
+rvc_select (RVC_Client* c)
+{
+	static const int32_t weight[RVC_N_PRIO] = { 0, RVC_WEIGHT_NORMAL, 1 };
+
+	if (rvc_queued_prio (c, RVC_PRIO_CRITICAL)) {
+		return RVC_PRIO_CRITICAL;
+	}
+
+	int     best  = -1;
+	int32_t total = 0;
+	for (int p = RVC_PRIO_NORMAL; p < RVC_N_PRIO; ++p) {
+		if (!rvc_queued_prio (c, (RVC_Priority)p)) {
+			c->wrr[p] = 0;
+			continue;
+		}
+		c->wrr[p] += weight[p];
+		total += weight[p];
+		if (best < 0 || c->wrr[p] > c->wrr[best]) {
+			best = p;
+		}
+	}
+	if (best >= 0) {
+		c->wrr[best] -= total;
+	}
+	return best;
+}
+
+/* issue the next queued request, if any.
+ * returns the parameter index of the issued request,
+ * RVC_NONE if there is nothing to issue or the host is busy (retry next cycle),
+ * or RVC_ERR_REJECTED if the host refused the request (it is dropped).
+ * In either case last_param is the parameter of the request.
+ */
+static inline int
+rvc_issue (RVC_Client* c)
+{
+	if (c->pending_prio < 0) {
+		c->pending_prio = rvc_select (c);
+	}
+	if (c->pending_prio < 0) {
+		return RVC_NONE;
+	}
+
+	const int        prio = c->pending_prio;
+	RVC_Request*     r    = &c->queue[prio][c->q_head[prio] & (RVC_MAX_QUEUE - 1)];
+	RVC_Param const* p    = &c->params[r->param];
+	const bool       msg  = r->msg[0] != '\0';
+
+	c->dialog_message.msg             = msg ? r->msg : NULL;
+	c->dialog_message.requires_return = r->requires_return;
+	c->last_param                     = r->param;
+
+	/* before the call, the host may free the message right away */
+	__atomic_store_n (&r->held, msg && c->host_frees, __ATOMIC_RELEASE);
+
+	switch (c->request_value->request (c->request_value->handle, p->property, p->type, c->features)) {
+		case LV2UI_REQUEST_VALUE_SUCCESS:
+			++c->q_head[prio];
+			c->pending_prio = -1;
+			return r->param;
+		case LV2UI_REQUEST_VALUE_BUSY:
+			__atomic_store_n (&r->held, false, __ATOMIC_RELEASE);
+			/* retry next cycle, unless a critical request arrives meanwhile */
+			if (rvc_queued_prio (c, RVC_PRIO_CRITICAL)) {
+				c->pending_prio = -1;
+			}
+			return RVC_NONE;
+		default:
+			__atomic_store_n (&r->held, false, __ATOMIC_RELEASE);
+			++c->q_head[prio];
+			c->pending_prio = -1;
+			return RVC_ERR_REJECTED;
+	}
+}
+
+#endif
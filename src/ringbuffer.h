@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_RINGBUFFER_H
+#define REQVAL_RINGBUFFER_H
+
+/* Lock-free ring-buffers for realtime <> non-realtime communication.
+ *
+ * SPSCRing: single producer, single consumer, variable-length records.
+ *           Both sides are wait-free.
+ *
+ * MPSCRing: multiple producers, single consumer, fixed size slots
+ *           holding records of up to `slot_size` bytes. Producers are
+ *           lock-free (CAS on the write index), the consumer is wait-free.
+ *           A producer that is preempted between claiming and publishing
+ *           a slot delays the consumer until it continues.
+ *
+ * Sizes are rounded up to the next power of two. Indices are free-running
+ * 32bit counters. Producer and consumer state are kept on separate cache
+ * lines to avoid false sharing.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef RING_CACHELINE
+#define RING_CACHELINE 64
+#endif
+
+static inline uint32_t
+ring_power_of_two (uint32_t size)
+{
+	uint32_t rv = 1;
+	while (rv < size && rv < (1U << 30)) {
+		rv <<= 1;
+	}
+	return rv;
+}
+
+/* ****************************************************************************
+ * SPSC, variable length records
+ *
+ * Each record is a 4 byte length header followed by the payload,
+ * padded to 8 bytes. Records are never split: if a record does not fit
+ * at the end of the buffer, a wrap marker is written and the record
+ * starts at the beginning.
+ */
+
+#define SPSC_WRAP 0xffffffffU
+
+typedef struct {
+	/* producer */
+	uint32_t write_idx;
+	uint32_t cached_read; // producer's copy of read_idx
+	char     _pad0[RING_CACHELINE - 2 * sizeof (uint32_t)];
+
+	/* consumer */
+	uint32_t read_idx;
+	uint32_t cached_write; // consumer's copy of write_idx
+	char     _pad1[RING_CACHELINE - 2 * sizeof (uint32_t)];
+
+	/* constant */
+	uint32_t size;
+	uint32_t mask;
+	uint8_t* buf;
+} SPSCRing;
+
+static inline uint32_t
+spsc_record_size (uint32_t len)
+{
+	return (len + sizeof (uint32_t) + 7U) & ~7U;
+}
+
+static inline SPSCRing*
+spsc_ring_new (uint32_t size)
+{
+	SPSCRing* r = (SPSCRing*)calloc (1, sizeof (SPSCRing));
+	if (!r) {
+		return NULL;
+	}
+	r->size = ring_power_of_two (size < 64 ? 64 : size);
+	r->mask = r->size - 1;
+	r->buf  = (uint8_t*)calloc (r->size, 1);
+	if (!r->buf) {
+		free (r);
+		return NULL;
+	}
+	return r;
+}
+
+static inline void
+spsc_ring_free (SPSCRing* r)
+{
+	if (r) {
+		free (r->buf);
+		free (r);
+	}
+}
+
+/* producer: append a record (len > 0), returns false if there is not enough space */
+static inline bool
+spsc_write (SPSCRing* r, void const* data, uint32_t len)
+{
+	if (len == 0) {
+		return false;
+	}
+
+	const uint32_t need = spsc_record_size (len);
+	const uint32_t w    = r->write_idx;
+	const uint32_t pos  = w & r->mask;
+	const uint32_t tail = r->size - pos; // contiguous space until wrap
+	const uint32_t want = need > tail ? need + tail : need;
+
+	if (need > r->size / 2) {
+		return false;
+	}
+
+	if (r->size - (w - r->cached_read) < want) {
+		r->cached_read = __atomic_load_n (&r->read_idx, __ATOMIC_ACQUIRE);
+		if (r->size - (w - r->cached_read) < want) {
+			return false;
+		}
+	}
+
+	uint8_t* p = r->buf + pos;
+	if (need > tail) {
+		*(uint32_t*)p = SPSC_WRAP;
+		p             = r->buf;
+	}
+	*(uint32_t*)p = len;
+	memcpy (p + sizeof (uint32_t), data, len);
+
+	__atomic_store_n (&r->write_idx, w + want, __ATOMIC_RELEASE);
+	return true;
+}
+
+/* consumer: returns a pointer to the next record's payload and sets `len`,
+ * or NULL if the buffer is empty. Call spsc_read_done () when finished.
+ */
+static inline void const*
+spsc_peek (SPSCRing* r, uint32_t* len)
+{
+	uint32_t rd = r->read_idx;
+
+	if (rd == r->cached_write) {
+		r->cached_write = __atomic_load_n (&r->write_idx, __ATOMIC_ACQUIRE);
+		if (rd == r->cached_write) {
+			return NULL;
+		}
+	}
+
+	uint8_t const* p = r->buf + (rd & r->mask);
+	if (*(uint32_t const*)p == SPSC_WRAP) {
+		p = r->buf;
+	}
+	*len = *(uint32_t const*)p;
+	return p + sizeof (uint32_t);
+}
+
+static inline void
+spsc_read_done (SPSCRing* r)
+{
+	const uint32_t rd   = r->read_idx;
+	const uint32_t pos  = rd & r->mask;
+	uint32_t       skip = 0;
+	uint8_t const* p    = r->buf + pos;
+
+	if (*(uint32_t const*)p == SPSC_WRAP) {
+		skip = r->size - pos;
+		p    = r->buf;
+	}
+	skip += spsc_record_size (*(uint32_t const*)p);
+	__atomic_store_n (&r->read_idx, rd + skip, __ATOMIC_RELEASE);
+}
+
+/* consumer: copy the next record to `data` (up to `max` bytes).
+ * returns the record length, or 0 if the buffer is empty.
+ * Records larger than `max` are truncated.
+ */
+static inline uint32_t
+spsc_read (SPSCRing* r, void* data, uint32_t max)
+{
+	uint32_t    len;
+	void const* p = spsc_peek (r, &len);
+	if (!p) {
+		return 0;
+	}
+	memcpy (data, p, len < max ? len : max);
+	spsc_read_done (r);
+	return len;
+}
+
+static inline bool
+spsc_empty (SPSCRing const* r)
+{
+	return __atomic_load_n (&r->write_idx, __ATOMIC_ACQUIRE) == __atomic_load_n (&r->read_idx, __ATOMIC_ACQUIRE);
+}
+
+/* ****************************************************************************
+ * MPSC, bounded, slot based (Vyukov)
+ *
+ * Each slot carries a sequence number: seq == idx means free for the
+ * producer claiming `idx`, seq == idx + 1 means published for the consumer.
+ */
+
+typedef struct {
+	uint32_t seq;
+	uint32_t len;
+} MPSCSlot;
+
+typedef struct {
+	/* producers */
+	uint32_t write_idx;
+	char     _pad0[RING_CACHELINE - sizeof (uint32_t)];
+
+	/* consumer */
+	uint32_t read_idx;
+	char     _pad1[RING_CACHELINE - sizeof (uint32_t)];
+
+	/* constant */
+	uint32_t n_slots;
+	uint32_t mask;
+	uint32_t slot_size;   // max payload per slot
+	uint32_t slot_stride; // header + payload, cache-line multiple
+	uint8_t* slots;
+} MPSCRing;
+
+static inline MPSCSlot*
+mpsc_slot (MPSCRing const* r, uint32_t idx)
+{
+	return (MPSCSlot*)(r->slots + (size_t)(idx & r->mask) * r->slot_stride);
+}
+
+static inline MPSCRing*
+mpsc_ring_new (uint32_t n_slots, uint32_t slot_size)
+{
+	MPSCRing* r = (MPSCRing*)calloc (1, sizeof (MPSCRing));
+	if (!r) {
+		return NULL;
+	}
+	r->n_slots     = ring_power_of_two (n_slots < 2 ? 2 : n_slots);
+	r->mask        = r->n_slots - 1;
+	r->slot_stride = (sizeof (MPSCSlot) + slot_size + RING_CACHELINE - 1) & ~(RING_CACHELINE - 1);
+	r->slot_size   = r->slot_stride - sizeof (MPSCSlot);
+	r->slots       = (uint8_t*)calloc (r->n_slots, r->slot_stride);
+	if (!r->slots) {
+		free (r);
+		return NULL;
+	}
+	for (uint32_t i = 0; i < r->n_slots; ++i) {
+		mpsc_slot (r, i)->seq = i;
+	}
+	return r;
+}
+
+static inline void
+mpsc_ring_free (MPSCRing* r)
+{
+	if (r) {
+		free (r->slots);
+		free (r);
+	}
+}
+
+/* producer (any thread): append a record (len > 0),
+ * returns false if the ring is full or len > slot_size
+ */
+static inline bool
+mpsc_write (MPSCRing* r, void const* data, uint32_t len)
+{
+	if (len == 0 || len > r->slot_size) {
+		return false;
+	}
+
+	uint32_t  idx = __atomic_load_n (&r->write_idx, __ATOMIC_RELAXED);
+	MPSCSlot* s;
+
+	for (;;) {
+		s                  = mpsc_slot (r, idx);
+		const uint32_t seq = __atomic_load_n (&s->seq, __ATOMIC_ACQUIRE);
+		const int32_t  dif = (int32_t)(seq - idx);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n (&r->write_idx, &idx, idx + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+			/* idx was updated by the failed CAS */
+		} else if (dif < 0) {
+			return false; // full
+		} else {
+			idx = __atomic_load_n (&r->write_idx, __ATOMIC_RELAXED);
+		}
+	}
+
+	s->len = len;
+	memcpy (s + 1, data, len);
+	__atomic_store_n (&s->seq, idx + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/* consumer: copy the next record to `data` (up to `max` bytes).
+ * returns the record length, or 0 if the ring is empty.
+ */
+static inline uint32_t
+mpsc_read (MPSCRing* r, void* data, uint32_t max)
+{
+	const uint32_t idx = r->read_idx;
+	MPSCSlot*      s   = mpsc_slot (r, idx);
+
+	if (__atomic_load_n (&s->seq, __ATOMIC_ACQUIRE) != idx + 1) {
+		return 0;
+	}
+
+	const uint32_t len = s->len;
+	memcpy (data, s + 1, len < max ? len : max);
+
+	__atomic_store_n (&s->seq, idx + r->n_slots, __ATOMIC_RELEASE);
+	__atomic_store_n (&r->read_idx, idx + 1, __ATOMIC_RELAXED);
+	return len;
+}
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_RULES_H
+#define REQVAL_RULES_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msgtemplate.h"
+#include "reqval_client.h"
+#include "workflow.h"
+
+/* Trigger rules, one per line:
+ *
+ *   when <cond> [and <cond>]... (request|ask) [critical|background] <parameter> ["message"]
+ *   when <cond> [and <cond>]... start <workflow>
+ *
+ *   cond:  level > <dBFS> [dBFS] [for <ms> [ms]]
+ *          level < <dBFS> [dBFS] [for <ms> [ms]]
+ *          rolling [for <ms> [ms]]
+ *          stopped [for <ms> [ms]]
+ *          after <ms> [ms]
+ *
+ * `ask` requires the host to return a value, `request` does not.
+ * The message is a template, see msgtemplate.h.
+ * Requests have normal priority unless specified otherwise.
+ * `start` runs a workflow, unless it is already running.
+ * Lines starting with '#' are comments.
+ *
+ * Rules are compiled by the worker into a fixed-size predicate
+ * table: levels are converted to linear gain and durations to
+ * samples, so that evaluation in run() is a bounded loop
+ * without any math library calls. A rule fires once when all
+ * conditions are met, and re-arms when any of them is false.
+ */
+
+#define RULES_MAX 32
+#define RULES_MAX_CONDS 4
+#define RULES_MSG_LEN 128
+
+typedef enum {
+	RULE_LEVEL_ABOVE,
+	RULE_LEVEL_BELOW,
+	RULE_ROLLING,
+	RULE_STOPPED,
+	RULE_AFTER,
+} RuleOp;
+
+typedef struct {
+	RuleOp   op;
+	float    level; // linear
+	uint64_t hold;  // samples the condition has to be true
+	uint64_t held;  // samples the condition has been true
+} RuleCond;
+
+typedef struct {
+	RuleCond    cond[RULES_MAX_CONDS];
+	uint32_t    n_cond;
+	int32_t     param;
+	int32_t     workflow; // -1: request `param`
+	int32_t     prio;
+	bool        requires_return;
+	bool        armed;
+	MsgTemplate msg;
+} Rule;
+
+typedef struct ReqValRules {
+	uint32_t            n_rules;
+	Rule                rule[RULES_MAX];
+	struct ReqValRules* retired; // next one the plugin has to free
+} ReqValRules;
+
+/* called by rules_eval () for each rule that fires, e.g. rvc_enqueue_prio */
+typedef RVC_Status (*RuleRequestFn) (void* arg, RVC_Priority prio, int param, MsgTemplate const* msg, bool requires_return);
+
+/* called by rules_eval () for each `start` rule that fires, e.g. wf_start */
+typedef bool (*RuleStartFn) (void* arg, int workflow);
+
+/* per cycle input to rules_eval () */
+typedef struct {
+	float    level;   // block peak, linear
+	bool     rolling; // transport state
+	uint64_t time;    // samples since instantiate, end of the block
+	uint32_t n_samples;
+} RuleInput;
+
+/* ****************************************************************************
+ * Compiler, not realtime safe
+ */
+
+/* return the next token, a word or a quoted string, NULL at end of line */
+static const char*
+rules_token (const char** p, char* tok, size_t len)
+{
+	const char* s = *p;
+	size_t      n = 0;
+
+	while (*s == ' ' || *s == '\t') {
+		++s;
+	}
+	if (*s == '\0' || *s == '\n' || *s == '\r') {
+		*p = s;
+		return NULL;
+	}
+	if (*s == '"') {
+		++s;
+		while (*s && *s != '"' && n + 1 < len) {
+			tok[n++] = *s++;
+		}
+		if (*s == '"') {
+			++s;
+		}
+	} else {
+		while (*s && *s != ' ' && *s != '\t' && *s != '\n' && *s != '\r' && n + 1 < len) {
+			tok[n++] = *s++;
+		}
+	}
+	tok[n] = '\0';
+	*p     = s;
+	return tok;
+}
+
+static bool
+rules_number (const char* tok, double* v)
+{
+	char* end;
+	if (!tok) {
+		return false;
+	}
+	*v = strtod (tok, &end);
+	return end != tok && *end == '\0' && isfinite (*v);
+}
+
+/* parse "<ms> [ms]", returns samples or -1 */
+static int64_t
+rules_duration (const char** p, char* tok, size_t len, double rate)
+{
+	double ms;
+	if (!rules_number (rules_token (p, tok, len), &ms) || ms < 0) {
+		return -1;
+	}
+	const char* q = *p;
+	if (rules_token (&q, tok, len) && !strcmp (tok, "ms")) {
+		*p = q;
+	}
+	return (int64_t)rint (ms * rate / 1000.0);
+}
+
+/* compile one line and append it to the rule-set.
+ * returns 1 if a rule was added, 0 for blank lines and comments,
+ * -1 on syntax error and -2 if the rule-set is full.
+ */
+static int
+rules_compile_line (ReqValRules* rs, const char* line, double rate,
+                    RVC_ParamSpec const* params, uint32_t n_params,
+                    WorkflowDesc const* workflows, uint32_t n_workflows)
+{
+	char        tok[RULES_MSG_LEN];
+	const char* p = line;
+
+	if (!rules_token (&p, tok, sizeof (tok)) || tok[0] == '#') {
+		return 0;
+	}
+	if (strcmp (tok, "when")) {
+		return -1;
+	}
+	if (rs->n_rules >= RULES_MAX) {
+		return -2;
+	}
+
+	Rule* r = &rs->rule[rs->n_rules];
+	memset (r, 0, sizeof (Rule));
+	r->armed    = true;
+	r->workflow = -1;
+	r->prio     = RVC_PRIO_NORMAL;
+
+	while (true) {
+		if (!rules_token (&p, tok, sizeof (tok)) || r->n_cond >= RULES_MAX_CONDS) {
+			return -1;
+		}
+
+		RuleCond* c = &r->cond[r->n_cond++];
+
+		if (!strcmp (tok, "level")) {
+			double db;
+			if (!rules_token (&p, tok, sizeof (tok)) || (strcmp (tok, ">") && strcmp (tok, "<"))) {
+				return -1;
+			}
+			c->op = tok[0] == '>' ? RULE_LEVEL_ABOVE : RULE_LEVEL_BELOW;
+			if (!rules_number (rules_token (&p, tok, sizeof (tok)), &db)) {
+				return -1;
+			}
+			c->level = powf (10.f, .05f * (float)db);
+		} else if (!strcmp (tok, "rolling")) {
+			c->op = RULE_ROLLING;
+		} else if (!strcmp (tok, "stopped")) {
+			c->op = RULE_STOPPED;
+		} else if (!strcmp (tok, "after")) {
+			const int64_t t = rules_duration (&p, tok, sizeof (tok), rate);
+			if (t < 0) {
+				return -1;
+			}
+			c->op   = RULE_AFTER;
+			c->hold = t;
+		} else {
+			return -1;
+		}
+
+		/* optional unit and hold time */
+		if (!rules_token (&p, tok, sizeof (tok))) {
+			return -1;
+		}
+		if (!strcmp (tok, "dB") || !strcmp (tok, "dBFS")) {
+			if (!rules_token (&p, tok, sizeof (tok))) {
+				return -1;
+			}
+		}
+		if (!strcmp (tok, "for") && c->op != RULE_AFTER) {
+			const int64_t t = rules_duration (&p, tok, sizeof (tok), rate);
+			if (t < 0 || !rules_token (&p, tok, sizeof (tok))) {
+				return -1;
+			}
+			c->hold = t;
+		}
+
+		if (!strcmp (tok, "and")) {
+			continue;
+		}
+		if (!strcmp (tok, "request") || !strcmp (tok, "ask")) {
+			r->requires_return = tok[0] == 'a';
+			break;
+		}
+		if (!strcmp (tok, "start")) {
+			if (!rules_token (&p, tok, sizeof (tok)) || (r->workflow = wf_find (workflows, n_workflows, tok)) < 0) {
+				return -1;
+			}
+			if (rules_token (&p, tok, sizeof (tok))) {
+				return -1;
+			}
+			++rs->n_rules;
+			return 1;
+		}
+		return -1;
+	}
+
+	if (!rules_token (&p, tok, sizeof (tok))) {
+		return -1;
+	}
+	if (!strcmp (tok, "critical") || !strcmp (tok, "background")) {
+		r->prio = tok[0] == 'c' ? RVC_PRIO_CRITICAL : RVC_PRIO_BACKGROUND;
+		if (!rules_token (&p, tok, sizeof (tok))) {
+			return -1;
+		}
+	}
+	if ((r->param = rvc_find_symbol (params, n_params, tok)) < 0) {
+		return -1;
+	}
+	if (!rules_token (&p, tok, sizeof (tok))) {
+		snprintf (tok, sizeof (tok), "Rule %u", rs->n_rules + 1);
+	}
+	if (!mt_compile (&r->msg, tok, params, n_params)) {
+		return -1;
+	}
+	if (rules_token (&p, tok, sizeof (tok))) {
+		return -1;
+	}
+
+	++rs->n_rules;
+	return 1;
+}
+
+/* ****************************************************************************
+ * Evaluation, realtime safe, O(RULES_MAX * RULES_MAX_CONDS)
+ *
+ * With `defer` set only critical requests fire. Other rules that are
+ * due stay armed and fire once evaluation is no longer deferred.
+ * Conditions are tracked either way, so hold times stay current.
+ */
+
+static inline uint32_t
+rules_eval (ReqValRules* rs, RuleInput const* in, bool defer, RuleRequestFn request, RuleStartFn start, void* arg)
+{
+	uint32_t fired = 0;
+
+	for (uint32_t i = 0; i < rs->n_rules; ++i) {
+		Rule* r   = &rs->rule[i];
+		bool  all = true;
+
+		for (uint32_t k = 0; k < r->n_cond; ++k) {
+			RuleCond* cd = &r->cond[k];
+			bool      v  = false;
+			switch (cd->op) {
+				case RULE_LEVEL_ABOVE:
+					v = in->level > cd->level;
+					break;
+				case RULE_LEVEL_BELOW:
+					v = in->level < cd->level;
+					break;
+				case RULE_ROLLING:
+					v = in->rolling;
+					break;
+				case RULE_STOPPED:
+					v = !in->rolling;
+					break;
+				case RULE_AFTER:
+					all = all && in->time >= cd->hold;
+					continue;
+			}
+			cd->held = v ? cd->held + in->n_samples : 0;
+			all      = all && v && cd->held >= cd->hold;
+		}
+
+		if (!all) {
+			r->armed = true;
+		} else if (!r->armed || (defer && (r->workflow >= 0 || r->prio != RVC_PRIO_CRITICAL))) {
+			continue;
+		} else if (r->workflow >= 0) {
+			/* a running workflow is not restarted, the rule fires once anyway */
+			start (arg, r->workflow);
+			r->armed = false;
+			++fired;
+		} else if (RVC_OK == request (arg, (RVC_Priority)r->prio, r->param, &r->msg, r->requires_return)) {
+			/* if the queue is full, stay armed and retry next cycle */
+			r->armed = false;
+			++fired;
+		}
+	}
+	return fired;
+}
+
+#endif
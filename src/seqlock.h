@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_SEQLOCK_H
+#define REQVAL_SEQLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Single writer sequence lock.
+ *
+ * The writer (realtime thread) never blocks, readers retry
+ * until they got a consistent copy. The sequence number is even
+ * when the data is stable, and doubles as generation counter:
+ * it changes if and only if new data was published.
+ */
+
+typedef struct {
+	volatile uint32_t seq;
+} SeqLock;
+
+static inline void
+seqlock_write_begin (SeqLock* sl)
+{
+	__atomic_store_n (&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+static inline void
+seqlock_write_end (SeqLock* sl)
+{
+	__atomic_store_n (&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* copy `size` bytes from `src` to `dst`, returns the generation of the copy */
+static inline uint32_t
+seqlock_read (SeqLock const* sl, void* dst, void const* src, size_t size)
+{
+	uint32_t s0, s1;
+	do {
+		s0 = __atomic_load_n (&sl->seq, __ATOMIC_ACQUIRE);
+		if (s0 & 1) {
+			continue;
+		}
+		memcpy (dst, src, size);
+		__atomic_thread_fence (__ATOMIC_ACQUIRE);
+		s1 = __atomic_load_n (&sl->seq, __ATOMIC_RELAXED);
+	} while ((s0 & 1) || s0 != s1);
+	return s0;
+}
+
+static inline uint32_t
+seqlock_generation (SeqLock const* sl)
+{
+	return __atomic_load_n (&sl->seq, __ATOMIC_ACQUIRE) & ~1U;
+}
+
+#endif
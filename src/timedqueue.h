@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_TIMEDQUEUE_H
+#define REQVAL_TIMEDQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Fixed capacity queue of internal events due at a given sample time.
+ *
+ * Binary min-heap ordered by time, events due at the same time are
+ * returned in the order they were posted. Realtime safe, single threaded.
+ */
+
+#define TQ_MAX_EVENTS 32
+
+typedef struct {
+	uint64_t    time; // absolute sample time
+	uint32_t    seq;  // insertion order, tie-break
+	uint32_t    type; // user defined
+	int32_t     param;
+	int32_t     prio;
+	bool        requires_return;
+	void const* msg; // user defined, e.g. a message template
+} TimedEvent;
+
+typedef struct {
+	TimedEvent ev[TQ_MAX_EVENTS];
+	uint32_t   n_events;
+	uint32_t   seq;
+} TimedQueue;
+
+static inline bool
+tq_less (TimedEvent const* a, TimedEvent const* b)
+{
+	return a->time < b->time || (a->time == b->time && (int32_t)(a->seq - b->seq) < 0);
+}
+
+static inline void
+tq_swap (TimedQueue* q, uint32_t a, uint32_t b)
+{
+	const TimedEvent t = q->ev[a];
+	q->ev[a]           = q->ev[b];
+	q->ev[b]           = t;
+}
+
+static inline void
+tq_init (TimedQueue* q)
+{
+	q->n_events = 0;
+	q->seq      = 0;
+}
+
+static inline bool
+tq_post (TimedQueue* q, TimedEvent const* ev)
+{
+	if (q->n_events >= TQ_MAX_EVENTS) {
+		return false;
+	}
+	uint32_t i = q->n_events++;
+	q->ev[i]     = *ev;
+	q->ev[i].seq = q->seq++;
+	while (i > 0 && tq_less (&q->ev[i], &q->ev[(i - 1) / 2])) {
+		tq_swap (q, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+	return true;
+}
+
+/* return the earliest event, NULL if the queue is empty */
+static inline TimedEvent const*
+tq_peek (TimedQueue const* q)
+{
+	return q->n_events > 0 ? &q->ev[0] : NULL;
+}
+
+static inline void
+tq_pop (TimedQueue* q, TimedEvent* ev)
+{
+	*ev      = q->ev[0];
+	q->ev[0] = q->ev[--q->n_events];
+
+	uint32_t i = 0;
+	while (true) {
+		const uint32_t l = 2 * i + 1;
+		const uint32_t r = l + 1;
+		uint32_t       s = i;
+		if (l < q->n_events && tq_less (&q->ev[l], &q->ev[s])) {
+			s = l;
+		}
+		if (r < q->n_events && tq_less (&q->ev[r], &q->ev[s])) {
+			s = r;
+		}
+		if (s == i) {
+			break;
+		}
+		tq_swap (q, i, s);
+		i = s;
+	}
+}
+
+#endif
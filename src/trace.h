@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_TRACE_H
+#define REQVAL_TRACE_H
+
+/* Optional per-instance timeline tracing, enabled at compile-time
+ * with `make TRACE=yes` (-DREQVAL_TRACE).
+ *
+ * run() records compact binary events into a lock-free ring, a
+ * non-realtime writer thread converts them to Chrome trace-event JSON
+ * (chrome://tracing, ui.perfetto.dev). One file per instance is written
+ * to $REQVAL_TRACE_DIR (default /tmp).
+ *
+ * Without REQVAL_TRACE the TRACE() macro expands to nothing.
+ */
+
+typedef enum {
+	TRACE_CYCLE_BEGIN = 0,
+	TRACE_CYCLE_END,
+	TRACE_DECODE_BEGIN,
+	TRACE_DECODE_END,
+	TRACE_REQUEST,
+	TRACE_SET,
+} TraceEventType;
+
+#ifdef REQVAL_TRACE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ringbuffer.h"
+
+#define TRACE_RING_SIZE 65536
+#define TRACE_INTERVAL_NS 50000000
+
+typedef struct {
+	uint64_t ts; // CLOCK_MONOTONIC, nsec
+	uint32_t type;
+	uint32_t arg;
+} TraceEvent;
+
+typedef struct {
+	SPSCRing* ring;
+	FILE*     f;
+	pthread_t thread;
+	bool      running;
+	bool      paused; // set by run(), see watchdog.h
+	uint32_t  id;
+	uint32_t  dropped;
+	uint32_t  n_written;
+} Tracer;
+
+static inline uint64_t
+trace_now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* realtime-safe, called from run() */
+static inline void
+trace_event (Tracer* t, uint32_t type, uint32_t arg)
+{
+	if (!t->ring || t->paused) {
+		return;
+	}
+	TraceEvent ev = { trace_now (), type, arg };
+	if (!spsc_write (t->ring, &ev, sizeof (ev))) {
+		__atomic_add_fetch (&t->dropped, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void
+trace_write_event (Tracer* t, TraceEvent const* ev)
+{
+	static const char* const names[] = { "run", "run", "decode", "decode", "request", "set" };
+	static const char        phase[] = { 'B', 'E', 'B', 'E', 'i', 'i' };
+
+	if (ev->type > TRACE_SET) {
+		return;
+	}
+
+	fprintf (t->f, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u",
+	         t->n_written ? "," : "", names[ev->type], phase[ev->type],
+	         ev->ts / 1000.0, (int)getpid (), t->id);
+
+	switch (ev->type) {
+		case TRACE_CYCLE_BEGIN:
+			fprintf (t->f, ",\"args\":{\"n_samples\":%u}", ev->arg);
+			break;
+		case TRACE_REQUEST:
+		case TRACE_SET:
+			fprintf (t->f, ",\"s\":\"t\",\"args\":{\"param\":%u}", ev->arg);
+			break;
+		default:
+			break;
+	}
+	fputc ('}', t->f);
+	++t->n_written;
+}
+
+static void
+trace_drain (Tracer* t)
+{
+	TraceEvent ev;
+	while (spsc_read (t->ring, &ev, sizeof (ev)) == sizeof (ev)) {
+		trace_write_event (t, &ev);
+	}
+	fflush (t->f);
+}
+
+static void*
+trace_thread (void* arg)
+{
+	Tracer*         t  = (Tracer*)arg;
+	struct timespec ts = { 0, TRACE_INTERVAL_NS };
+	while (__atomic_load_n (&t->running, __ATOMIC_ACQUIRE)) {
+		nanosleep (&ts, NULL);
+		trace_drain (t);
+	}
+	return NULL;
+}
+
+static inline bool
+trace_init (Tracer* t)
+{
+	static uint32_t instance_cnt = 0;
+
+	char        path[1024];
+	const char* dir = getenv ("REQVAL_TRACE_DIR");
+
+	t->id = __atomic_add_fetch (&instance_cnt, 1, __ATOMIC_RELAXED);
+	snprintf (path, sizeof (path), "%s/reqval-trace-%d-%u.json", dir ? dir : "/tmp", (int)getpid (), t->id);
+
+	if (!(t->f = fopen (path, "w"))) {
+		return false;
+	}
+	if (!(t->ring = spsc_ring_new (TRACE_RING_SIZE))) {
+		fclose (t->f);
+		return false;
+	}
+
+	fprintf (t->f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	t->running = true;
+	if (pthread_create (&t->thread, NULL, trace_thread, t)) {
+		spsc_ring_free (t->ring);
+		fclose (t->f);
+		t->ring = NULL;
+		return false;
+	}
+	return true;
+}
+
+static inline void
+trace_cleanup (Tracer* t)
+{
+	if (!t->ring) {
+		return;
+	}
+	__atomic_store_n (&t->running, false, __ATOMIC_RELEASE);
+	pthread_join (t->thread, NULL);
+	trace_drain (t);
+	fprintf (t->f, "\n],\"metadata\":{\"dropped\":%u}}\n", t->dropped);
+	fclose (t->f);
+	spsc_ring_free (t->ring);
+	t->ring = NULL;
+}
+
+#define TRACE(self, type, arg) trace_event (&(self)->tracer, type, arg)
+
+#else
+
+#define TRACE(self, type, arg)
+
+#endif
+#endif
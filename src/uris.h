@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_URIS_H
+#define REQVAL_URIS_H
+
+#define REQVAL_URI "http://gareus.org/oss/lv2/request_value"
+
+/* parameters, see also parameters.spec */
+#define REQVAL__acktest REQVAL_URI "#acktest"
+
+/* DSP <> UI messages */
+#define REQVAL__ui_on REQVAL_URI "#ui_on"
+#define REQVAL__ui_off REQVAL_URI "#ui_off"
+#define REQVAL__state REQVAL_URI "#state"
+#define REQVAL__n_requests REQVAL_URI "#n_requests"
+#define REQVAL__n_answers REQVAL_URI "#n_answers"
+#define REQVAL__pending REQVAL_URI "#pending"
+#define REQVAL__have_answer REQVAL_URI "#have_answer"
+#define REQVAL__last_answer REQVAL_URI "#last_answer"
+#define REQVAL__latency REQVAL_URI "#latency"
+#define REQVAL__n_clamped REQVAL_URI "#n_clamped"
+#define REQVAL__n_rejected REQVAL_URI "#n_rejected"
+#define REQVAL__n_cached REQVAL_URI "#n_cached"
+#define REQVAL__load_level REQVAL_URI "#load_level"
+#define REQVAL__n_overruns REQVAL_URI "#n_overruns"
+#define REQVAL__history REQVAL_URI "#history"
+
+/* port indices */
+enum {
+	REQVAL_CONTROL = 0,
+	REQVAL_INPUT,
+	REQVAL_OUTPUT,
+	REQVAL_NOTIFY,
+	REQVAL_SIDECHAIN,
+	REQVAL_LATENCY,
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_WATCHDOG_H
+#define REQVAL_WATCHDOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* run() overrun watchdog.
+ *
+ * The cost of each cycle is compared to its share of the block's
+ * real-time budget, n_samples / sample_rate * WD_BUDGET. Every
+ * overrun steps up one degradation level, each sheds more optional
+ * work. After WD_RECOVER_CYCLES consecutive cycles below
+ * WD_RECOVER_LOAD, the level steps down again.
+ *
+ * Time is read with CLOCK_MONOTONIC, which is a vDSO call without
+ * a syscall on common platforms. Realtime safe, single threaded.
+ */
+
+#define WD_BUDGET .5
+#define WD_RECOVER_LOAD .25
+#define WD_RECOVER_CYCLES 256
+
+/* audio split granularity at WD_COARSE and above, power of two */
+#define WD_COARSE_GRID 64
+
+typedef enum {
+	WD_NORMAL = 0,
+	WD_NO_TRACE, // tracing is paused
+	WD_COARSE,   // audio is split at WD_COARSE_GRID, not at every event
+	WD_DEFER,    // non-critical internal events and rules, and UI updates wait
+	WD_N_LEVELS
+} WatchdogLevel;
+
+typedef struct {
+	uint64_t t_start;   // nsec
+	uint64_t cost;      // nsec, last cycle
+	float    load;      // cost of the last cycle, relative to the budget
+	uint32_t level;
+	uint32_t n_below;   // consecutive cycles below WD_RECOVER_LOAD
+	uint32_t n_overruns;
+} Watchdog;
+
+static inline uint64_t
+wd_now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void
+wd_begin (Watchdog* w)
+{
+	w->t_start = wd_now ();
+}
+
+/* returns true if the level changed */
+static inline bool
+wd_end (Watchdog* w, uint32_t n_samples, double rate)
+{
+	if (n_samples == 0) {
+		return false;
+	}
+	const double budget = n_samples * 1e9 * WD_BUDGET / rate;
+	w->cost             = wd_now () - w->t_start;
+	w->load             = w->cost / budget;
+
+	if (w->load > 1.f) {
+		++w->n_overruns;
+		w->n_below = 0;
+		if (w->level + 1 < WD_N_LEVELS) {
+			++w->level;
+			return true;
+		}
+	} else if (w->load < WD_RECOVER_LOAD && w->level > WD_NORMAL) {
+		if (++w->n_below >= WD_RECOVER_CYCLES) {
+			w->n_below = 0;
+			--w->level;
+			return true;
+		}
+	} else {
+		w->n_below = 0;
+	}
+	return false;
+}
+
+#endif
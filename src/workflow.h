@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_WORKFLOW_H
+#define REQVAL_WORKFLOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Multi-step request workflows, resumable state machines.
+ *
+ * A workflow is a function written as a stackless coroutine with the
+ * WF_* macros: the resume point is stored in the WorkflowState and
+ * the function body is a switch on it. Each step issues at most one
+ * request and yields. The workflow is resumed when the awaited
+ * parameter is set (wf_answer) or when the step times out
+ * (wf_timeout), `timed_out` tells which.
+ *
+ * Local variables do not survive WF_AWAIT, keep state in the
+ * plugin instance. Only one WF_AWAIT per source line.
+ *
+ *   static WorkflowResult
+ *   confirm (WorkflowState* wf, void* arg)
+ *   {
+ *     WF_BEGIN (wf);
+ *     WF_AWAIT (wf, ask (arg, wf, P_confirm, "Continue?", 30000));
+ *     if (wf->timed_out) {
+ *       WF_EXIT (wf);
+ *     }
+ *     ...
+ *     WF_END (wf);
+ *   }
+ *
+ * Realtime safe, single threaded, no allocation.
+ */
+
+#define WF_MAX 8
+
+typedef enum {
+	WF_WAIT = 0, // waiting for an answer or timeout
+	WF_DONE,
+	WF_ABORT, // a request could not be issued
+} WorkflowResult;
+
+typedef struct {
+	uint32_t pc;        // resume point, 0: start
+	int32_t  param;     // awaited parameter, -1: none
+	uint64_t deadline;  // sample time at which the step times out
+	bool     running;
+	bool     timed_out; // the last step ended without an answer
+} WorkflowState;
+
+typedef WorkflowResult (*WorkflowFn) (WorkflowState* wf, void* arg);
+
+typedef struct {
+	const char* name;
+	WorkflowFn  fn;
+} WorkflowDesc;
+
+typedef struct {
+	WorkflowDesc const* desc;
+	WorkflowState       state[WF_MAX];
+	uint32_t            n;
+} WorkflowEngine;
+
+#define WF_BEGIN(wf) \
+	switch ((wf)->pc) { \
+		case 0:
+
+/* `issue` sends the request and calls wf_await (), it evaluates to false on failure */
+#define WF_AWAIT(wf, issue) \
+	do { \
+		(wf)->pc = __LINE__; \
+		if (!(issue)) { \
+			return WF_ABORT; \
+		} \
+		return WF_WAIT; \
+		case __LINE__:; \
+	} while (0)
+
+#define WF_EXIT(wf) return WF_DONE
+
+#define WF_END(wf) \
+	} \
+	return WF_DONE
+
+static inline void
+wf_init (WorkflowEngine* e, WorkflowDesc const* desc, uint32_t n)
+{
+	memset (e, 0, sizeof (WorkflowEngine));
+	e->desc = desc;
+	e->n    = n < WF_MAX ? n : WF_MAX;
+	for (uint32_t i = 0; i < e->n; ++i) {
+		e->state[i].param = -1;
+	}
+}
+
+/* not realtime safe, e.g. for the rules compiler */
+static int
+wf_find (WorkflowDesc const* desc, uint32_t n, const char* name)
+{
+	for (uint32_t i = 0; i < n; ++i) {
+		if (!strcmp (desc[i].name, name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* called by a workflow's `issue` expression, before it yields */
+static inline void
+wf_await (WorkflowState* wf, int32_t param, uint64_t deadline)
+{
+	wf->param     = param;
+	wf->deadline  = deadline;
+	wf->timed_out = false;
+}
+
+static inline WorkflowResult
+wf_step (WorkflowEngine* e, uint32_t i, void* arg)
+{
+	WorkflowState*       wf = &e->state[i];
+	const WorkflowResult r  = e->desc[i].fn (wf, arg);
+	if (r != WF_WAIT) {
+		wf->running = false;
+		wf->param   = -1;
+		wf->pc      = 0;
+	}
+	return r;
+}
+
+/* returns false if the workflow does not exist or is already running */
+static inline bool
+wf_start (WorkflowEngine* e, int i, void* arg)
+{
+	if (i < 0 || (uint32_t)i >= e->n || e->state[i].running) {
+		return false;
+	}
+	WorkflowState* wf = &e->state[i];
+	wf->pc            = 0;
+	wf->param         = -1;
+	wf->timed_out     = false;
+	wf->running       = true;
+	wf_step (e, i, arg);
+	return true;
+}
+
+/* resume all workflows waiting for `param`, returns the number resumed */
+static inline uint32_t
+wf_answer (WorkflowEngine* e, int32_t param, void* arg)
+{
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < e->n; ++i) {
+		WorkflowState* wf = &e->state[i];
+		if (wf->running && wf->param == param) {
+			wf->param = -1;
+			wf_step (e, i, arg);
+			++n;
+		}
+	}
+	return n;
+}
+
+/* resume a workflow whose step is due at `time`, timeouts of
+ * steps that have been answered meanwhile are ignored */
+static inline bool
+wf_timeout (WorkflowEngine* e, int i, uint64_t time, void* arg)
+{
+	if (i < 0 || (uint32_t)i >= e->n) {
+		return false;
+	}
+	WorkflowState* wf = &e->state[i];
+	if (!wf->running || wf->param < 0 || wf->deadline != time) {
+		return false;
+	}
+	wf->param     = -1;
+	wf->timed_out = true;
+	wf_step (e, i, arg);
+	return true;
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef REQVAL_WORKTHREAD_H
+#define REQVAL_WORKTHREAD_H
+
+/* Fallback for hosts that do not provide LV2 Worker.
+ *
+ * A plugin-owned non-realtime thread emulates LV2_Worker_Schedule:
+ * schedule_work() appends to a lock-free ring and posts a semaphore,
+ * the thread waits for it and calls the plugin's work(). Responses
+ * are queued in a second ring and passed to work_response() by
+ * workthread_deliver(), which the plugin calls at the end of run(),
+ * the same context a host uses.
+ *
+ * Messages are copied to an aligned buffer before they are handed on,
+ * the plugin's messages contain pointers.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#else
+#include <semaphore.h>
+#endif
+
+#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
+#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
+
+#include "ringbuffer.h"
+
+#define WORKTHREAD_RING_SIZE 16384
+#define WORKTHREAD_MSG_SIZE 2048
+#define WORKTHREAD_INTERVAL_NS 10000000
+
+typedef union {
+	uint64_t align;
+	uint8_t  data[WORKTHREAD_MSG_SIZE];
+} WorkThreadMsg;
+
+#ifdef __APPLE__
+typedef semaphore_t WorkThreadSem;
+
+static inline bool
+workthread_sem_init (WorkThreadSem* sem)
+{
+	return KERN_SUCCESS == semaphore_create (mach_task_self (), sem, SYNC_POLICY_FIFO, 0);
+}
+
+static inline void
+workthread_sem_destroy (WorkThreadSem* sem)
+{
+	semaphore_destroy (mach_task_self (), *sem);
+}
+
+static inline void
+workthread_sem_post (WorkThreadSem* sem)
+{
+	semaphore_signal (*sem);
+}
+
+static inline void
+workthread_sem_wait (WorkThreadSem* sem)
+{
+	semaphore_wait (*sem);
+}
+#else
+typedef sem_t WorkThreadSem;
+
+static inline bool
+workthread_sem_init (WorkThreadSem* sem)
+{
+	return 0 == sem_init (sem, 0, 0);
+}
+
+static inline void
+workthread_sem_destroy (WorkThreadSem* sem)
+{
+	sem_destroy (sem);
+}
+
+static inline void
+workthread_sem_post (WorkThreadSem* sem)
+{
+	sem_post (sem);
+}
+
+static inline void
+workthread_sem_wait (WorkThreadSem* sem)
+{
+	while (sem_wait (sem) && errno == EINTR) {
+		;
+	}
+}
+#endif
+
+typedef struct {
+	LV2_Worker_Schedule         schedule; // passed to the plugin
+	LV2_Worker_Interface const* iface;
+	LV2_Handle                  instance;
+	SPSCRing*                   requests;  // run() -> thread
+	SPSCRing*                   responses; // thread -> run()
+	WorkThreadSem               sem; // posted for each request
+	pthread_t                   thread;
+	bool                        running;
+} WorkThread;
+
+/* realtime-safe, called from run() */
+static LV2_Worker_Status
+workthread_schedule (LV2_Worker_Schedule_Handle handle, uint32_t size, const void* data)
+{
+	WorkThread* w = (WorkThread*)handle;
+	if (size > WORKTHREAD_MSG_SIZE || !spsc_write (w->requests, data, size)) {
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
+	workthread_sem_post (&w->sem);
+	return LV2_WORKER_SUCCESS;
+}
+
+static inline bool workthread_deliver (WorkThread* w);
+
+/* called from work(), a response is never dropped, it may carry data
+ * that would otherwise leak. While the thread runs, wait for space.
+ * Once it is stopping, run() no longer drains the ring: deliver the
+ * queued responses and this one in the calling thread */
+static LV2_Worker_Status
+workthread_respond (LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+{
+	WorkThread*     w  = (WorkThread*)handle;
+	struct timespec ts = { 0, WORKTHREAD_INTERVAL_NS };
+
+	if (size > WORKTHREAD_MSG_SIZE) {
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
+	while (!spsc_write (w->responses, data, size)) {
+		if (!__atomic_load_n (&w->running, __ATOMIC_ACQUIRE)) {
+			WorkThreadMsg msg;
+			memcpy (msg.data, data, size);
+			workthread_deliver (w);
+			w->iface->work_response (w->instance, size, msg.data);
+			break;
+		}
+		nanosleep (&ts, NULL);
+	}
+	return LV2_WORKER_SUCCESS;
+}
+
+static bool
+workthread_process (WorkThread* w)
+{
+	WorkThreadMsg msg;
+	uint32_t      len;
+	bool          rv = false;
+	while ((len = spsc_read (w->requests, msg.data, sizeof (msg.data))) > 0) {
+		w->iface->work (w->instance, workthread_respond, w, len, msg.data);
+		rv = true;
+	}
+	return rv;
+}
+
+static void*
+workthread_main (void* arg)
+{
+	WorkThread* w = (WorkThread*)arg;
+	while (true) {
+		workthread_sem_wait (&w->sem);
+		if (!__atomic_load_n (&w->running, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+		workthread_process (w);
+	}
+	return NULL;
+}
+
+/* realtime-safe, called at the end of run() */
+static inline bool
+workthread_deliver (WorkThread* w)
+{
+	WorkThreadMsg msg;
+	uint32_t      len;
+	bool          rv = false;
+	if (!w->responses) {
+		return false;
+	}
+	while ((len = spsc_read (w->responses, msg.data, sizeof (msg.data))) > 0) {
+		w->iface->work_response (w->instance, len, msg.data);
+		rv = true;
+	}
+	return rv;
+}
+
+static inline bool
+workthread_start (WorkThread* w, LV2_Worker_Interface const* iface, LV2_Handle instance)
+{
+	w->iface    = iface;
+	w->instance = instance;
+
+	w->schedule.handle        = w;
+	w->schedule.schedule_work = workthread_schedule;
+
+	w->requests  = spsc_ring_new (WORKTHREAD_RING_SIZE);
+	w->responses = spsc_ring_new (WORKTHREAD_RING_SIZE);
+
+	if (!w->requests || !w->responses || !workthread_sem_init (&w->sem)) {
+		spsc_ring_free (w->requests);
+		spsc_ring_free (w->responses);
+		w->requests  = NULL;
+		w->responses = NULL;
+		return false;
+	}
+
+	w->running = true;
+	if (pthread_create (&w->thread, NULL, workthread_main, w)) {
+		workthread_sem_destroy (&w->sem);
+		spsc_ring_free (w->requests);
+		spsc_ring_free (w->responses);
+		w->requests  = NULL;
+		w->responses = NULL;
+		w->running   = false;
+		return false;
+	}
+	return true;
+}
+
+/* join the thread, then complete all outstanding work in the
+ * calling thread, so that nothing in flight is leaked.
+ * Not concurrent with run() */
+static inline void
+workthread_stop (WorkThread* w)
+{
+	if (!w->requests) {
+		return;
+	}
+	__atomic_store_n (&w->running, false, __ATOMIC_RELEASE);
+	workthread_sem_post (&w->sem);
+	pthread_join (w->thread, NULL);
+
+	/* responses may schedule more work, which posts the semaphore */
+	while (workthread_process (w) | workthread_deliver (w)) {
+		;
+	}
+	workthread_sem_destroy (&w->sem);
+
+	spsc_ring_free (w->requests);
+	spsc_ring_free (w->responses);
+	w->requests  = NULL;
+	w->responses = NULL;
+}
+
+#endif
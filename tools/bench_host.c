@@ -0,0 +1,1056 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Headless benchmark host for the plugin
+ *
+ *   make bench
+ *   ./build/bench_host [-c] [-n cycles] [-b blocksize] [-e events] [-j file] [plugin.so]
+ *   ./build/bench_host -s [-j file] [plugin.so]
+ *
+ * Loads the plugin, and calls run() with a synthetic workload:
+ * `events` patch:Set messages per cycle, evenly spaced, alternating
+ * the gain parameter. Requests are acknowledged immediately, worker
+ * jobs are executed synchronously after each cycle, outside the
+ * measured section.
+ *
+ * With -c, hardware counters (cycles, instructions, cache- and branch
+ * misses) are read around each run() call using perf_event_open.
+ * If perf events are not permitted (see /proc/sys/kernel/perf_event_paranoid)
+ * only wall-clock time is reported.
+ *
+ * With -j, results are also written as JSON, see `make perf-check`.
+ *
+ * With -s, a block-size sweep is run instead: the same input signal
+ * and the same timeline of parameter changes are processed with fixed,
+ * random and event-aligned block-size schedules, including zero and
+ * one sample cycles. The output must be bit-identical to the reference
+ * (one sample per cycle), and every request must be issued at the end
+ * of the cycle that contains the sample at which the reference issued
+ * it. The cost per sample is reported for each fixed block size.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
+#include <lv2/lv2plug.in/ns/ext/log/log.h>
+#include <lv2/lv2plug.in/ns/ext/patch/patch.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
+#include <lv2/lv2plug.in/ns/extensions/ui/ui.h>
+#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
+
+#include "../src/uris.h"
+
+#define MAX_URIDS 256
+#define MAX_WORK 64
+#define ATOM_BUFSIZ 65536
+
+typedef const LV2_Descriptor* (*DescriptorFunction) (uint32_t index);
+
+typedef union {
+	LV2_Atom_Sequence seq;
+	uint8_t           raw[ATOM_BUFSIZ];
+} AtomBuffer;
+
+/* ****************************************************************************
+ * host features
+ */
+
+static char*    urids[MAX_URIDS];
+static uint32_t n_urids = 0;
+
+static LV2_URID
+map_uri (LV2_URID_Map_Handle handle, const char* uri)
+{
+	for (uint32_t i = 0; i < n_urids; ++i) {
+		if (!strcmp (urids[i], uri)) {
+			return i + 1;
+		}
+	}
+	if (n_urids >= MAX_URIDS) {
+		return 0;
+	}
+	urids[n_urids] = strdup (uri);
+	return ++n_urids;
+}
+
+static uint32_t n_log = 0;
+
+static int
+log_vprintf (LV2_Log_Handle handle, LV2_URID type, const char* fmt, va_list ap)
+{
+	++n_log;
+	return 0;
+}
+
+static int
+log_printf (LV2_Log_Handle handle, LV2_URID type, const char* fmt, ...)
+{
+	++n_log;
+	return 0;
+}
+
+static uint32_t n_requests = 0;
+
+/* requests are recorded during a sweep, see sweep_run () */
+typedef struct {
+	uint64_t time; // end of the cycle that issued the request
+	LV2_URID key;
+} RequestRecord;
+
+#define MAX_RECORDS 64
+
+static RequestRecord* rec_log  = NULL;
+static uint32_t       n_rec    = 0;
+static uint64_t       rec_time = 0;
+
+static LV2UI_Request_Value_Status
+request_value (LV2UI_Feature_Handle handle, LV2_URID key, LV2_URID type, const LV2_Feature* const* features)
+{
+	++n_requests;
+	if (rec_log && n_rec < MAX_RECORDS) {
+		rec_log[n_rec].time = rec_time;
+		rec_log[n_rec].key  = key;
+		++n_rec;
+	}
+	return LV2UI_REQUEST_VALUE_SUCCESS;
+}
+
+typedef struct {
+	uint32_t size;
+	uint64_t data[(ATOM_BUFSIZ / 16) / sizeof (uint64_t)];
+} WorkItem;
+
+static WorkItem work_q[MAX_WORK];
+static uint32_t n_work = 0;
+static WorkItem resp_q[MAX_WORK];
+static uint32_t n_resp = 0;
+
+static LV2_Worker_Status
+queue_item (WorkItem* q, uint32_t* n, uint32_t size, const void* data)
+{
+	if (*n >= MAX_WORK || size > sizeof (q[0].data)) {
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
+	q[*n].size = size;
+	memcpy (q[*n].data, data, size);
+	++*n;
+	return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status
+schedule_work (LV2_Worker_Schedule_Handle handle, uint32_t size, const void* data)
+{
+	return queue_item (work_q, &n_work, size, data);
+}
+
+static LV2_Worker_Status
+respond (LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+{
+	return queue_item (resp_q, &n_resp, size, data);
+}
+
+static void
+run_worker (const LV2_Worker_Interface* iface, LV2_Handle instance)
+{
+	while (iface && (n_work > 0 || n_resp > 0)) {
+		static WorkItem q[MAX_WORK];
+		uint32_t        n = n_work;
+		memcpy (q, work_q, n * sizeof (WorkItem));
+		n_work = 0;
+		for (uint32_t i = 0; i < n; ++i) {
+			iface->work (instance, respond, NULL, q[i].size, q[i].data);
+		}
+		n = n_resp;
+		memcpy (q, resp_q, n * sizeof (WorkItem));
+		n_resp = 0;
+		for (uint32_t i = 0; i < n; ++i) {
+			iface->work_response (instance, q[i].size, q[i].data);
+		}
+	}
+}
+
+/* ****************************************************************************
+ * counters
+ */
+
+enum {
+	CNT_CYCLES = 0,
+	CNT_INSTRUCTIONS,
+	CNT_CACHE_MISSES,
+	CNT_BRANCH_MISSES,
+	N_COUNTERS
+};
+
+static const char* counter_name[N_COUNTERS] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+
+typedef struct {
+	int      fd[N_COUNTERS]; // fd[0] is the group leader
+	bool     enabled;
+	uint64_t total[N_COUNTERS];
+} Counters;
+
+static uint64_t
+now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool
+counters_open (Counters* c)
+{
+	memset (c, 0, sizeof (Counters));
+#ifdef __linux__
+	static const uint64_t config[N_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	for (int i = 0; i < N_COUNTERS; ++i) {
+		struct perf_event_attr pe;
+		memset (&pe, 0, sizeof (pe));
+		pe.type           = PERF_TYPE_HARDWARE;
+		pe.size           = sizeof (pe);
+		pe.config         = config[i];
+		pe.disabled       = i == 0;
+		pe.exclude_kernel = 1;
+		pe.exclude_hv     = 1;
+		pe.read_format    = PERF_FORMAT_GROUP;
+
+		c->fd[i] = syscall (__NR_perf_event_open, &pe, 0, -1, i == 0 ? -1 : c->fd[0], 0);
+		if (c->fd[i] < 0) {
+			perror ("perf_event_open");
+			while (--i >= 0) {
+				close (c->fd[i]);
+			}
+			return false;
+		}
+	}
+	ioctl (c->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl (c->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	c->enabled = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void
+counters_close (Counters* c)
+{
+	if (!c->enabled) {
+		return;
+	}
+	for (int i = 0; i < N_COUNTERS; ++i) {
+		close (c->fd[i]);
+	}
+	c->enabled = false;
+}
+
+static bool
+counters_read (Counters const* c, uint64_t* val)
+{
+	struct {
+		uint64_t nr;
+		uint64_t val[N_COUNTERS];
+	} rd;
+	if (!c->enabled || read (c->fd[0], &rd, sizeof (rd)) != sizeof (rd) || rd.nr != N_COUNTERS) {
+		return false;
+	}
+	memcpy (val, rd.val, sizeof (rd.val));
+	return true;
+}
+
+/* ****************************************************************************
+ * workload
+ */
+
+static void
+forge_cycle (LV2_Atom_Forge* forge, uint8_t* buf, uint32_t n_events, uint32_t n_samples, uint32_t cycle,
+             LV2_URID patch_Set, LV2_URID patch_property, LV2_URID patch_value, LV2_URID gain)
+{
+	LV2_Atom_Forge_Frame seq;
+	lv2_atom_forge_set_buffer (forge, buf, ATOM_BUFSIZ);
+	lv2_atom_forge_sequence_head (forge, &seq, 0);
+
+	for (uint32_t i = 0; i < n_events; ++i) {
+		LV2_Atom_Forge_Frame frame;
+		lv2_atom_forge_frame_time (forge, (int64_t)i * n_samples / n_events);
+		lv2_atom_forge_object (forge, &frame, 0, patch_Set);
+		lv2_atom_forge_key (forge, patch_property);
+		lv2_atom_forge_urid (forge, gain);
+		lv2_atom_forge_key (forge, patch_value);
+		lv2_atom_forge_float (forge, ((cycle + i) & 1) ? -6.f : 0.f);
+		lv2_atom_forge_pop (forge, &frame);
+	}
+	lv2_atom_forge_pop (forge, &seq);
+}
+
+/* ****************************************************************************
+ * block-size sweep
+ */
+
+#define SWEEP_LEN 120000 // samples, 2.5 sec at 48 kHz
+#define SWEEP_MAX_EVENTS 32
+#define SWEEP_FLUSH 2048 // final cycle, not compared, to receive the last state
+#define SWEEP_RETRY 3
+
+typedef struct {
+	uint64_t time;
+	LV2_URID property;
+	bool     is_bool;
+	float    value;
+} SweepEvent;
+
+typedef struct {
+	const char* name;
+	uint32_t    n_block; // fixed size
+	uint32_t    seed;    // random sizes if n_block is 0, aligned to events if both are 0
+} Schedule;
+
+typedef struct {
+	const LV2_Descriptor*     d;
+	const LV2_Feature* const* features;
+	double                    rate;
+
+	LV2_Atom_Forge forge;
+	LV2_URID       atom_Int;
+	LV2_URID       patch_Set;
+	LV2_URID       patch_property;
+	LV2_URID       patch_value;
+	LV2_URID       ui_on;
+	LV2_URID       state;
+	LV2_URID       n_overruns;
+
+	SweepEvent ev[SWEEP_MAX_EVENTS];
+	uint32_t   n_ev;
+	float*     in;
+	float*     out;
+	float*     ref;
+	uint32_t*  blocks;
+	uint32_t   max_blocks;
+} Sweep;
+
+static void
+sweep_event (Sweep* sw, uint64_t time, const char* property, bool is_bool, float value)
+{
+	if (sw->n_ev < SWEEP_MAX_EVENTS) {
+		SweepEvent* e = &sw->ev[sw->n_ev++];
+		e->time       = time;
+		e->property   = map_uri (NULL, property);
+		e->is_bool    = is_bool;
+		e->value      = value;
+	}
+}
+
+static uint32_t
+sweep_rand (uint32_t* s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+static int
+cmp_u32 (const void* a, const void* b)
+{
+	const uint32_t x = *(const uint32_t*)a;
+	const uint32_t y = *(const uint32_t*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* fill sw->blocks with the cycle sizes, returns the number of cycles */
+static uint32_t
+sweep_schedule (Sweep* sw, Schedule const* sc)
+{
+	uint32_t n = 0;
+
+	if (sc->n_block == 0 && sc->seed == 0) {
+		/* cycles end one sample before, at, and one sample after
+		 * each event, with an empty cycle at the event */
+		uint32_t* bound = sw->blocks;
+		for (uint32_t i = 0; i < sw->n_ev; ++i) {
+			const uint32_t t = sw->ev[i].time;
+			if (t > 0) {
+				bound[n++] = t - 1;
+			}
+			bound[n++] = t;
+			bound[n++] = t;
+			bound[n++] = t + 1;
+		}
+		for (uint32_t t = 4096; t < SWEEP_LEN; t += 4096) {
+			bound[n++] = t;
+		}
+		bound[n++] = SWEEP_LEN;
+		qsort (bound, n, sizeof (uint32_t), cmp_u32);
+		uint32_t prev = 0;
+		for (uint32_t i = 0; i < n; ++i) {
+			const uint32_t t = bound[i];
+			bound[i]         = t - prev;
+			prev             = t;
+		}
+		return n;
+	}
+
+	uint32_t pos = 0;
+	uint32_t rng = sc->seed;
+	while (pos < SWEEP_LEN && n < sw->max_blocks) {
+		uint32_t len = sc->n_block;
+		if (len == 0) {
+			const uint32_t r = sweep_rand (&rng);
+			len              = (r & 7) == 0 ? 0 : ((r & 7) == 1 ? 1 : (r >> 3) % 1500);
+		}
+		if (len > SWEEP_LEN - pos) {
+			len = SWEEP_LEN - pos;
+		}
+		sw->blocks[n++] = len;
+		pos += len;
+	}
+	return n;
+}
+
+/* the end of the cycle that contains sample `s` */
+static uint64_t
+sweep_cycle_end (uint32_t const* blocks, uint32_t n_blocks, uint64_t s)
+{
+	uint64_t pos = 0;
+	for (uint32_t i = 0; i < n_blocks; ++i) {
+		pos += blocks[i];
+		if (s < pos) {
+			return pos;
+		}
+	}
+	return pos;
+}
+
+/* process the sweep input with the given schedule in a new instance,
+ * returns false if the plugin cannot be instantiated */
+static bool
+sweep_run (Sweep* sw, uint32_t n_blocks, float* out, RequestRecord* rec, uint32_t* n_records,
+           uint64_t* t_run, uint32_t* overruns)
+{
+	static AtomBuffer control;
+	static AtomBuffer notify;
+	static float      silence[SWEEP_FLUSH];
+	static float      scratch[SWEEP_FLUSH];
+	float             latency = 0;
+
+	const LV2_Descriptor* d = sw->d;
+	LV2_Handle            h = d->instantiate (d, sw->rate, "", sw->features);
+	if (!h) {
+		return false;
+	}
+
+	const LV2_Worker_Interface* worker = d->extension_data ? (const LV2_Worker_Interface*)d->extension_data (LV2_WORKER__interface) : NULL;
+
+	d->connect_port (h, REQVAL_CONTROL, &control);
+	d->connect_port (h, REQVAL_NOTIFY, &notify);
+	d->connect_port (h, REQVAL_LATENCY, &latency);
+	if (d->activate) {
+		d->activate (h);
+	}
+
+	rec_log   = rec;
+	n_rec     = 0;
+	*t_run    = 0;
+	*overruns = 0;
+
+	uint64_t pos = 0;
+	uint32_t e   = 0;
+
+	for (uint32_t b = 0; b <= n_blocks; ++b) {
+		const bool     flush = b == n_blocks;
+		const uint32_t n     = flush ? SWEEP_FLUSH : sw->blocks[b];
+
+		LV2_Atom_Forge*      forge = &sw->forge;
+		LV2_Atom_Forge_Frame seq;
+		LV2_Atom_Forge_Frame frame;
+		lv2_atom_forge_set_buffer (forge, control.raw, ATOM_BUFSIZ);
+		lv2_atom_forge_sequence_head (forge, &seq, 0);
+		if (b == 0) {
+			lv2_atom_forge_frame_time (forge, 0);
+			lv2_atom_forge_object (forge, &frame, 0, sw->ui_on);
+			lv2_atom_forge_pop (forge, &frame);
+		}
+		for (; !flush && e < sw->n_ev && sw->ev[e].time < pos + n; ++e) {
+			lv2_atom_forge_frame_time (forge, sw->ev[e].time - pos);
+			lv2_atom_forge_object (forge, &frame, 0, sw->patch_Set);
+			lv2_atom_forge_key (forge, sw->patch_property);
+			lv2_atom_forge_urid (forge, sw->ev[e].property);
+			lv2_atom_forge_key (forge, sw->patch_value);
+			if (sw->ev[e].is_bool) {
+				lv2_atom_forge_bool (forge, sw->ev[e].value != 0);
+			} else {
+				lv2_atom_forge_float (forge, sw->ev[e].value);
+			}
+			lv2_atom_forge_pop (forge, &frame);
+		}
+		lv2_atom_forge_pop (forge, &seq);
+		notify.seq.atom.size = sizeof (notify) - sizeof (LV2_Atom);
+
+		/* hosts may re-connect buffers before each cycle */
+		d->connect_port (h, REQVAL_INPUT, flush ? silence : sw->in + pos);
+		d->connect_port (h, REQVAL_SIDECHAIN, flush ? silence : sw->in + pos);
+		d->connect_port (h, REQVAL_OUTPUT, flush ? scratch : out + pos);
+
+		if (flush) {
+			rec_log = NULL;
+		}
+		rec_time = pos + n;
+
+		const uint64_t t0 = now_ns ();
+		d->run (h, n);
+		const uint64_t t1 = now_ns ();
+
+		if (!flush) {
+			*t_run += t1 - t0;
+		}
+
+		run_worker (worker, h);
+
+		LV2_ATOM_SEQUENCE_FOREACH (&notify.seq, ev)
+		{
+			const LV2_Atom_Object* obj = (const LV2_Atom_Object*)&ev->body;
+			const LV2_Atom*        cnt = NULL;
+			if (obj->body.otype == sw->state) {
+				lv2_atom_object_get (obj, sw->n_overruns, &cnt, 0);
+			}
+			if (cnt && cnt->type == sw->atom_Int) {
+				*overruns = ((const LV2_Atom_Int*)cnt)->body;
+			}
+		}
+
+		pos += n;
+	}
+
+	rec_log    = NULL;
+	*n_records = n_rec;
+
+	if (d->deactivate) {
+		d->deactivate (h);
+	}
+	d->cleanup (h);
+	return true;
+}
+
+/* run a schedule, retry if the plugin's watchdog may have
+ * degraded processing, returns false on error */
+static bool
+sweep_try (Sweep* sw, Schedule const* sc, uint32_t* n_blocks, float* out, RequestRecord* rec, uint32_t* n_records,
+           uint64_t* t_run, uint32_t* overruns)
+{
+	*n_blocks = sweep_schedule (sw, sc);
+	for (int i = 0; i < SWEEP_RETRY; ++i) {
+		if (!sweep_run (sw, *n_blocks, out, rec, n_records, t_run, overruns)) {
+			return false;
+		}
+		if (*overruns < 2) {
+			break;
+		}
+	}
+	return true;
+}
+
+static int
+sweep (const LV2_Descriptor* d, const LV2_Feature* const* features, double rate, const char* json_path)
+{
+	static const Schedule schedules[] = {
+		{ "fixed 1", 1, 0 },
+		{ "fixed 2", 2, 0 },
+		{ "fixed 3", 3, 0 },
+		{ "fixed 7", 7, 0 },
+		{ "fixed 16", 16, 0 },
+		{ "fixed 63", 63, 0 },
+		{ "fixed 64", 64, 0 },
+		{ "fixed 127", 127, 0 },
+		{ "fixed 256", 256, 0 },
+		{ "fixed 1023", 1023, 0 },
+		{ "fixed 4096", 4096, 0 },
+		{ "fixed 8192", 8192, 0 },
+		{ "random 1", 0, 1 },
+		{ "random 2", 0, 2 },
+		{ "random 3", 0, 3 },
+		{ "random 4", 0, 4 },
+		{ "events", 0, 0 },
+	};
+
+	Sweep sw;
+	memset (&sw, 0, sizeof (sw));
+	sw.d        = d;
+	sw.features = features;
+	sw.rate     = rate;
+
+	LV2_URID_Map map = { NULL, map_uri };
+	lv2_atom_forge_init (&sw.forge, &map);
+	sw.atom_Int       = map_uri (NULL, LV2_ATOM__Int);
+	sw.patch_Set      = map_uri (NULL, LV2_PATCH__Set);
+	sw.patch_property = map_uri (NULL, LV2_PATCH__property);
+	sw.patch_value    = map_uri (NULL, LV2_PATCH__value);
+	sw.ui_on          = map_uri (NULL, REQVAL__ui_on);
+	sw.state          = map_uri (NULL, REQVAL__state);
+	sw.n_overruns     = map_uri (NULL, REQVAL__n_overruns);
+
+	/* gain changes close to each other and to power-of-two boundaries,
+	 * lookahead on and off, and an answer that re-arms the sidechain trigger */
+	sweep_event (&sw, 0, REQVAL_URI "#gain", false, -6.f);
+	sweep_event (&sw, 1, REQVAL_URI "#gain", false, 0.f);
+	sweep_event (&sw, 777, REQVAL_URI "#gain", false, 3.f);
+	sweep_event (&sw, 4095, REQVAL_URI "#gain", false, -12.f);
+	sweep_event (&sw, 4096, REQVAL_URI "#gain", false, -3.f);
+	sweep_event (&sw, 4097, REQVAL_URI "#gain", false, -9.f);
+	sweep_event (&sw, 12345, REQVAL_URI "#gain", false, 0.f);
+	sweep_event (&sw, 24000, REQVAL_URI "#lookahead", true, 1);
+	sweep_event (&sw, 24100, REQVAL_URI "#gain", false, -1.5f);
+	sweep_event (&sw, 47999, REQVAL_URI "#gain", false, 6.f);
+	sweep_event (&sw, 48000, REQVAL_URI "#gain", false, -6.f);
+	sweep_event (&sw, 60000, REQVAL_URI "#booltest", true, 1);
+	sweep_event (&sw, 72000, REQVAL_URI "#lookahead", true, 0);
+	sweep_event (&sw, 72000, REQVAL_URI "#gain", false, 0.f);
+	sweep_event (&sw, 100003, REQVAL_URI "#gain", false, -20.f);
+
+	/* a sine, with two bursts above the sidechain threshold */
+	sw.in         = (float*)calloc (SWEEP_LEN, sizeof (float));
+	sw.out        = (float*)calloc (SWEEP_LEN, sizeof (float));
+	sw.ref        = (float*)calloc (SWEEP_LEN, sizeof (float));
+	sw.max_blocks = SWEEP_LEN + 4 * SWEEP_MAX_EVENTS + SWEEP_LEN / 4096 + 1;
+	sw.blocks     = (uint32_t*)calloc (sw.max_blocks, sizeof (uint32_t));
+
+	for (uint32_t i = 0; i < SWEEP_LEN; ++i) {
+		const bool burst = (i >= 24011 && i < 25011) || (i >= 90001 && i < 91001);
+		sw.in[i]         = (burst ? .6f : .25f) * sinf (2.f * 3.14159265f * 997.f * i / rate);
+	}
+
+	RequestRecord ref_rec[MAX_RECORDS];
+	RequestRecord rec[MAX_RECORDS];
+	uint32_t      n_ref_rec, n_blocks, n_ref_blocks, overruns;
+	uint64_t      t_run;
+	int           rv = EXIT_SUCCESS;
+
+	FILE* json = json_path ? fopen (json_path, "w") : NULL;
+	if (json_path && !json) {
+		perror (json_path);
+		rv = EXIT_FAILURE;
+	}
+	if (json) {
+		fprintf (json, "{\n  \"benchmark\": \"bench_host sweep\",\n  \"samples\": %u,\n  \"metrics\": {\n", SWEEP_LEN);
+	}
+
+	/* the reference, one sample per cycle */
+	if (!sweep_try (&sw, &schedules[0], &n_ref_blocks, sw.ref, ref_rec, &n_ref_rec, &t_run, &overruns)) {
+		fprintf (stderr, "Cannot instantiate plugin\n");
+		rv = EXIT_FAILURE;
+		goto out;
+	}
+
+	printf ("%u samples, %u events, %u requests\n", SWEEP_LEN, sw.n_ev, n_ref_rec);
+	printf ("%-12s %8s %10s  %s\n", "schedule", "cycles", "ns/sample", "result");
+
+	for (uint32_t s = 0; s < sizeof (schedules) / sizeof (schedules[0]); ++s) {
+		Schedule const* sc = &schedules[s];
+		uint32_t        n_records;
+
+		if (s == 0) {
+			/* cost of the reference, results are compared to themselves */
+			memcpy (sw.out, sw.ref, SWEEP_LEN * sizeof (float));
+			memcpy (rec, ref_rec, sizeof (rec));
+			n_records = n_ref_rec;
+			n_blocks  = n_ref_blocks;
+			sweep_schedule (&sw, sc);
+		} else if (!sweep_try (&sw, sc, &n_blocks, sw.out, rec, &n_records, &t_run, &overruns)) {
+			rv = EXIT_FAILURE;
+			break;
+		}
+
+		char     result[128] = "ok";
+		uint32_t i;
+		for (i = 0; i < SWEEP_LEN && !memcmp (&sw.out[i], &sw.ref[i], sizeof (float)); ++i) {
+		}
+		if (i < SWEEP_LEN) {
+			snprintf (result, sizeof (result), "FAIL: audio differs at sample %u (%.9g != %.9g)", i, sw.out[i], sw.ref[i]);
+		} else if (n_records != n_ref_rec) {
+			snprintf (result, sizeof (result), "FAIL: %u requests, expected %u", n_records, n_ref_rec);
+		} else {
+			for (i = 0; i < n_records; ++i) {
+				/* the reference issues a request at the end of the
+				 * sample at which it became due */
+				const uint64_t expect = sweep_cycle_end (sw.blocks, n_blocks, ref_rec[i].time - 1);
+				if (rec[i].key != ref_rec[i].key || rec[i].time != expect) {
+					snprintf (result, sizeof (result), "FAIL: request %u at sample %lu, expected %lu",
+					          i, (unsigned long)rec[i].time, (unsigned long)expect);
+					break;
+				}
+			}
+		}
+		if (overruns >= 2) {
+			strncat (result, " (overruns)", sizeof (result) - strlen (result) - 1);
+		}
+		if (strncmp (result, "ok", 2)) {
+			rv = EXIT_FAILURE;
+		}
+
+		printf ("%-12s %8u %10.2f  %s\n", sc->name, n_blocks, t_run / (double)SWEEP_LEN, result);
+
+		if (json && sc->n_block > 0) {
+			fprintf (json, "    \"sweep_ns_per_sample_b%u\": %.3f,\n", sc->n_block, t_run / (double)SWEEP_LEN);
+		}
+	}
+
+out:
+	if (json) {
+		fprintf (json, "    \"sweep_failed\": %d\n  }\n}\n", rv != EXIT_SUCCESS);
+		fclose (json);
+	}
+
+	free (sw.in);
+	free (sw.out);
+	free (sw.ref);
+	free (sw.blocks);
+	return rv;
+}
+
+/* ****************************************************************************
+ * results
+ */
+
+#define INSTANTIATE_RUNS 32
+
+static int
+cmp_u64 (const void* a, const void* b)
+{
+	const uint64_t x = *(const uint64_t*)a;
+	const uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+typedef struct {
+	uint32_t n_cycles;
+	uint32_t n_block;
+	uint32_t n_events;
+	uint64_t t_init;  // min. instantiate time
+	uint64_t t_run;   // sum of all run() calls
+	uint64_t t_p50;
+	uint64_t t_p99;
+	uint64_t t_max;
+	Counters cnt;
+} Results;
+
+/* flat JSON, one metric per line, all metrics are "lower is better",
+ * see tools/perf_check.awk */
+static bool
+write_json (const char* path, Results const* r)
+{
+	FILE* f = fopen (path, "w");
+	if (!f) {
+		perror (path);
+		return false;
+	}
+
+	const double n_ev = (double)r->n_cycles * r->n_events;
+	const double n_sm = (double)r->n_cycles * r->n_block;
+
+	fprintf (f, "{\n");
+	fprintf (f, "  \"benchmark\": \"bench_host\",\n");
+	fprintf (f, "  \"cycles\": %u,\n", r->n_cycles);
+	fprintf (f, "  \"block_size\": %u,\n", r->n_block);
+	fprintf (f, "  \"events_per_cycle\": %u,\n", r->n_events);
+	fprintf (f, "  \"metrics\": {\n");
+	fprintf (f, "    \"instantiate_ns\": %.0f,\n", (double)r->t_init);
+	fprintf (f, "    \"run_ns_per_cycle\": %.2f,\n", r->t_run / (double)r->n_cycles);
+	fprintf (f, "    \"run_ns_p50\": %.0f,\n", (double)r->t_p50);
+	fprintf (f, "    \"run_ns_p99\": %.0f,\n", (double)r->t_p99);
+	fprintf (f, "    \"run_ns_max\": %.0f,\n", (double)r->t_max);
+	if (r->n_events > 0) {
+		fprintf (f, "    \"run_ns_per_event\": %.2f,\n", r->t_run / n_ev);
+	}
+	if (r->cnt.enabled) {
+		for (int k = 0; k < N_COUNTERS; ++k) {
+			fprintf (f, "    \"%s_per_cycle\": %.2f,\n", counter_name[k], r->cnt.total[k] / (double)r->n_cycles);
+		}
+	}
+	fprintf (f, "    \"run_ns_per_sample\": %.4f\n", r->t_run / n_sm);
+	fprintf (f, "  }\n}\n");
+
+	fclose (f);
+	return true;
+}
+
+static void
+usage (void)
+{
+	printf ("Usage: bench_host [-c] [-n cycles] [-b blocksize] [-e events] [-j file] [plugin.so]\n"
+	        "       bench_host -s [-j file] [plugin.so]\n"
+	        "  -c  read hardware performance counters\n"
+	        "  -n  number of run() calls (default 10000)\n"
+	        "  -b  samples per run() (default 256)\n"
+	        "  -e  patch:Set events per run() (default 4)\n"
+	        "  -j  write results as JSON to the given file\n"
+	        "  -s  compare output and request timing across block-size schedules\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	uint32_t    n_cycles  = 10000;
+	uint32_t    n_block   = 256;
+	uint32_t    n_events  = 4;
+	bool        use_perf  = false;
+	bool        do_sweep  = false;
+	const char* json_path = NULL;
+	double      rate      = 48000;
+
+	int c;
+	while ((c = getopt (argc, argv, "b:ce:hj:n:s")) != -1) {
+		switch (c) {
+			case 'b':
+				n_block = atoi (optarg);
+				break;
+			case 'c':
+				use_perf = true;
+				break;
+			case 'e':
+				n_events = atoi (optarg);
+				break;
+			case 'j':
+				json_path = optarg;
+				break;
+			case 'n':
+				n_cycles = atoi (optarg);
+				break;
+			case 's':
+				do_sweep = true;
+				break;
+			case 'h':
+				usage ();
+				return EXIT_SUCCESS;
+			default:
+				usage ();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (n_block < 1 || n_cycles < 1) {
+		usage ();
+		return EXIT_FAILURE;
+	}
+
+	const char* path = optind < argc ? argv[optind] : "build/request_value.so";
+
+	void* lib = dlopen (path, RTLD_NOW | RTLD_LOCAL);
+	if (!lib) {
+		fprintf (stderr, "Cannot load '%s': %s\n", path, dlerror ());
+		return EXIT_FAILURE;
+	}
+
+	DescriptorFunction    df = (DescriptorFunction)dlsym (lib, "lv2_descriptor");
+	const LV2_Descriptor* d  = df ? df (0) : NULL;
+	if (!d) {
+		fprintf (stderr, "'%s' is not an LV2 plugin\n", path);
+		dlclose (lib);
+		return EXIT_FAILURE;
+	}
+
+	LV2_URID_Map        map    = { NULL, map_uri };
+	LV2_Log_Log         log    = { NULL, log_printf, log_vprintf };
+	LV2UI_Request_Value reqval = { NULL, request_value };
+	LV2_Worker_Schedule sched  = { NULL, schedule_work };
+
+	const LV2_Feature f_map    = { LV2_URID__map, &map };
+	const LV2_Feature f_log    = { LV2_LOG__log, &log };
+	const LV2_Feature f_reqval = { LV2_UI__requestValue, &reqval };
+	const LV2_Feature f_sched  = { LV2_WORKER__schedule, &sched };
+
+	const LV2_Feature* features[] = { &f_map, &f_log, &f_reqval, &f_sched, NULL };
+
+	if (do_sweep) {
+		const int rv = sweep (d, features, rate, json_path);
+		dlclose (lib);
+		for (uint32_t i = 0; i < n_urids; ++i) {
+			free (urids[i]);
+		}
+		return rv;
+	}
+
+	Results res;
+	memset (&res, 0, sizeof (res));
+	res.n_cycles = n_cycles;
+	res.n_block  = n_block;
+	res.n_events = n_events;
+
+	/* instantiate is called once per session load, take the
+	 * best of a few runs to reduce noise */
+	LV2_Handle h = NULL;
+	for (int i = 0; i < INSTANTIATE_RUNS; ++i) {
+		if (h) {
+			d->cleanup (h);
+		}
+		const uint64_t t0 = now_ns ();
+		h                 = d->instantiate (d, rate, "", features);
+		const uint64_t dt = now_ns () - t0;
+		if (!h) {
+			break;
+		}
+		if (i == 0 || dt < res.t_init) {
+			res.t_init = dt;
+		}
+	}
+
+	if (!h) {
+		fprintf (stderr, "Cannot instantiate plugin\n");
+		dlclose (lib);
+		return EXIT_FAILURE;
+	}
+
+	const LV2_Worker_Interface* worker = d->extension_data ? (const LV2_Worker_Interface*)d->extension_data (LV2_WORKER__interface) : NULL;
+
+	/* ports */
+	static AtomBuffer control;
+	static AtomBuffer notify;
+	float*            in      = (float*)calloc (n_block, sizeof (float));
+	float*            out     = (float*)calloc (n_block, sizeof (float));
+	float*            sc      = (float*)calloc (n_block, sizeof (float));
+	uint64_t*         t_cycle = (uint64_t*)calloc (n_cycles, sizeof (uint64_t));
+	float             latency = 0;
+
+	for (uint32_t i = 0; i < n_block; ++i) {
+		in[i] = .5f * sinf (2.f * 3.14159265f * 1000.f * i / rate);
+	}
+
+	d->connect_port (h, REQVAL_CONTROL, &control);
+	d->connect_port (h, REQVAL_INPUT, in);
+	d->connect_port (h, REQVAL_OUTPUT, out);
+	d->connect_port (h, REQVAL_NOTIFY, &notify);
+	d->connect_port (h, REQVAL_SIDECHAIN, sc);
+	d->connect_port (h, REQVAL_LATENCY, &latency);
+
+	if (d->activate) {
+		d->activate (h);
+	}
+
+	LV2_Atom_Forge forge;
+	lv2_atom_forge_init (&forge, &map);
+
+	const LV2_URID patch_Set      = map_uri (NULL, LV2_PATCH__Set);
+	const LV2_URID patch_property = map_uri (NULL, LV2_PATCH__property);
+	const LV2_URID patch_value    = map_uri (NULL, LV2_PATCH__value);
+	const LV2_URID gain           = map_uri (NULL, REQVAL_URI "#gain");
+
+	Counters* cnt = &res.cnt;
+	if (use_perf && !counters_open (cnt)) {
+		fprintf (stderr, "Hardware counters are not available, using wall clock only.\n");
+	}
+
+	for (uint32_t i = 0; i < n_cycles; ++i) {
+		uint64_t c0[N_COUNTERS], c1[N_COUNTERS];
+
+		forge_cycle (&forge, control.raw, n_events, n_block, i, patch_Set, patch_property, patch_value, gain);
+		notify.seq.atom.size = sizeof (notify) - sizeof (LV2_Atom);
+
+		const bool     have_c0 = counters_read (cnt, c0);
+		const uint64_t t0      = now_ns ();
+
+		d->run (h, n_block);
+
+		const uint64_t t1 = now_ns ();
+		if (have_c0 && counters_read (cnt, c1)) {
+			for (int k = 0; k < N_COUNTERS; ++k) {
+				cnt->total[k] += c1[k] - c0[k];
+			}
+		}
+
+		t_cycle[i] = t1 - t0;
+		res.t_run += t1 - t0;
+
+		run_worker (worker, h);
+	}
+
+	qsort (t_cycle, n_cycles, sizeof (uint64_t), cmp_u64);
+	res.t_p50 = t_cycle[n_cycles / 2];
+	res.t_p99 = t_cycle[(uint32_t)(n_cycles * .99)];
+	res.t_max = t_cycle[n_cycles - 1];
+
+	const uint64_t n_ev = (uint64_t)n_cycles * n_events;
+	const uint64_t n_sm = (uint64_t)n_cycles * n_block;
+
+	printf ("%u cycles, %u samples/cycle, %u events/cycle, %u requests, %u log messages\n",
+	        n_cycles, n_block, n_events, n_requests, n_log);
+	printf ("instantiate: %10.0f ns\n", (double)res.t_init);
+	printf ("run:         %10.1f ns/cycle  (p50 %.0f ns, p99 %.0f ns, max %.0f ns)\n",
+	        res.t_run / (double)n_cycles, (double)res.t_p50, (double)res.t_p99, (double)res.t_max);
+	printf ("             %10.2f ns/sample\n", res.t_run / (double)n_sm);
+	if (n_ev > 0) {
+		printf ("             %10.1f ns/event\n", res.t_run / (double)n_ev);
+	}
+
+	if (cnt->enabled) {
+		for (int k = 0; k < N_COUNTERS; ++k) {
+			printf ("%-13s %10.1f /cycle %10.2f /sample", counter_name[k],
+			        cnt->total[k] / (double)n_cycles, cnt->total[k] / (double)n_sm);
+			if (n_ev > 0) {
+				printf (" %10.1f /event", cnt->total[k] / (double)n_ev);
+			}
+			printf ("\n");
+		}
+		if (cnt->total[CNT_CYCLES] > 0) {
+			printf ("IPC:          %10.2f\n", cnt->total[CNT_INSTRUCTIONS] / (double)cnt->total[CNT_CYCLES]);
+		}
+	}
+
+	int rv = EXIT_SUCCESS;
+	if (json_path && !write_json (json_path, &res)) {
+		rv = EXIT_FAILURE;
+	}
+
+	counters_close (cnt);
+
+	if (d->deactivate) {
+		d->deactivate (h);
+	}
+	d->cleanup (h);
+	dlclose (lib);
+
+	free (in);
+	free (out);
+	free (sc);
+	free (t_cycle);
+	for (uint32_t i = 0; i < n_urids; ++i) {
+		free (urids[i]);
+	}
+	return rv;
+}
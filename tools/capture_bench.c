@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Size and throughput of the capture encodings, see src/capture.h
+ *
+ *   make bench
+ *   ./build/capture_bench [n_cycles] [results.json]
+ *
+ * Encodes a synthetic automation-heavy session, patch:Set bursts,
+ * a time:Position every cycle while the transport rolls, and idle
+ * stretches, with both encodings, then decodes and compares it.
+ * Exits with an error if a decoded cycle differs from the input.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/patch/patch.h>
+#include <lv2/lv2plug.in/ns/ext/time/time.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+
+#include "../src/capture.h"
+#include "../src/uris.h"
+
+#define MAX_URIDS 64
+#define CYCLE_BUFSIZ 4096
+#define DECODE_RUNS 8 // best of, the file is in the page cache after the first
+
+static char*    urids[MAX_URIDS];
+static uint32_t n_urids = 0;
+
+static LV2_URID
+map_uri (LV2_URID_Map_Handle handle, const char* uri)
+{
+	for (uint32_t i = 0; i < n_urids; ++i) {
+		if (!strcmp (urids[i], uri)) {
+			return i + 1;
+		}
+	}
+	if (n_urids >= MAX_URIDS) {
+		return 0;
+	}
+	urids[n_urids] = strdup (uri);
+	return ++n_urids;
+}
+
+static inline uint64_t
+now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t
+xorshift (uint32_t* s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+typedef struct {
+	LV2_Atom_Forge forge;
+	LV2_URID       patch_Set;
+	LV2_URID       patch_property;
+	LV2_URID       patch_value;
+	LV2_URID       time_Position;
+	LV2_URID       time_frame;
+	LV2_URID       time_speed;
+	LV2_URID       time_bar;
+	LV2_URID       time_barBeat;
+	LV2_URID       param[3];
+} Session;
+
+typedef struct {
+	uint8_t* data; // n_cycles * CYCLE_BUFSIZ
+	uint32_t* n_samples;
+	uint32_t n_cycles;
+	uint64_t n_events;
+} Input;
+
+static LV2_Atom_Sequence*
+input_cycle (Input const* in, uint32_t i)
+{
+	return (LV2_Atom_Sequence*)(in->data + (size_t)i * CYCLE_BUFSIZ);
+}
+
+/* 8 sec stretches, alternating rolling with automation and idle */
+static void
+generate (Session* s, Input* in)
+{
+	uint32_t rng   = 1;
+	uint64_t frame = 0;
+
+	for (uint32_t i = 0; i < in->n_cycles; ++i) {
+		LV2_Atom_Forge*      forge = &s->forge;
+		LV2_Atom_Forge_Frame seq, obj;
+		const bool           rolling = (i / 1500) & 1;
+		const uint32_t       n       = (i % 3000) == 2999 ? 128 : 256;
+
+		in->n_samples[i] = n;
+
+		lv2_atom_forge_set_buffer (forge, (uint8_t*)input_cycle (in, i), CYCLE_BUFSIZ);
+		lv2_atom_forge_sequence_head (forge, &seq, 0);
+
+		if (rolling) {
+			lv2_atom_forge_frame_time (forge, 0);
+			lv2_atom_forge_object (forge, &obj, 0, s->time_Position);
+			lv2_atom_forge_key (forge, s->time_frame);
+			lv2_atom_forge_long (forge, frame);
+			lv2_atom_forge_key (forge, s->time_speed);
+			lv2_atom_forge_float (forge, 1.f);
+			lv2_atom_forge_key (forge, s->time_bar);
+			lv2_atom_forge_long (forge, frame / 96000);
+			lv2_atom_forge_key (forge, s->time_barBeat);
+			lv2_atom_forge_float (forge, (frame % 96000) / 24000.f);
+			lv2_atom_forge_pop (forge, &obj);
+			++in->n_events;
+
+			/* automation, a few parameter changes per cycle */
+			const uint32_t n_set = xorshift (&rng) % 6;
+			uint32_t       t     = 0;
+			for (uint32_t k = 0; k < n_set; ++k) {
+				const uint32_t p = xorshift (&rng) % 3;
+				t += xorshift (&rng) % (n / n_set);
+				lv2_atom_forge_frame_time (forge, t);
+				lv2_atom_forge_object (forge, &obj, 0, s->patch_Set);
+				lv2_atom_forge_key (forge, s->patch_property);
+				lv2_atom_forge_urid (forge, s->param[p]);
+				lv2_atom_forge_key (forge, s->patch_value);
+				if (p == 0) {
+					lv2_atom_forge_float (forge, -20.f + (xorshift (&rng) % 2400) / 100.f);
+				} else {
+					lv2_atom_forge_bool (forge, xorshift (&rng) & 1);
+				}
+				lv2_atom_forge_pop (forge, &obj);
+				++in->n_events;
+			}
+			frame += n;
+		}
+		lv2_atom_forge_pop (forge, &seq);
+	}
+}
+
+static bool
+encode (Input const* in, const char* path, CaptureFormat format, LV2_URID atom_Object, LV2_URID atom_URID, uint64_t* t)
+{
+	static CaptureWriter w;
+
+	const uint64_t t0 = now_ns ();
+	if (!cap_writer_open (&w, path, format, atom_Object, atom_URID)) {
+		perror (path);
+		return false;
+	}
+	bool ok = true;
+	for (uint32_t i = 0; i < in->n_cycles; ++i) {
+		ok = cap_write_cycle (&w, i, in->n_samples[i], input_cycle (in, i)) && ok;
+	}
+	ok = cap_writer_close (&w, urids, n_urids) && ok;
+	*t = now_ns () - t0;
+	return ok;
+}
+
+/* decode all cycles, compare them to the input if `verify` is set */
+static bool
+decode (Input const* in, const char* path, bool verify, uint64_t* t)
+{
+	static CaptureReader r;
+	static union {
+		LV2_Atom_Sequence seq;
+		uint8_t           raw[CYCLE_BUFSIZ];
+	} buf;
+
+	const uint64_t t0 = now_ns ();
+	if (!cap_reader_open (&r, path)) {
+		fprintf (stderr, "Cannot read '%s'\n", path);
+		return false;
+	}
+
+	uint64_t cycle;
+	uint32_t n_samples, n = 0;
+	int      rv;
+	bool     ok = r.n_uris == n_urids;
+
+	while (ok && (rv = cap_read_cycle (&r, &cycle, &n_samples, &buf.seq, sizeof (buf))) > 0) {
+		if (verify) {
+			LV2_Atom_Sequence const* ref = input_cycle (in, n);
+			ok = cycle == n && n_samples == in->n_samples[n] && buf.seq.atom.size == ref->atom.size
+			     && !memcmp (&buf.seq.body, &ref->body, ref->atom.size);
+		}
+		++n;
+	}
+	cap_reader_close (&r);
+	*t = now_ns () - t0;
+
+	if (!ok || rv < 0 || n != in->n_cycles) {
+		fprintf (stderr, "'%s': cycle %u differs from the input\n", path, n - (ok ? 0 : 1));
+		return false;
+	}
+	return true;
+}
+
+static long
+file_size (const char* path)
+{
+	FILE* f = fopen (path, "rb");
+	long  n = -1;
+	if (f && !fseek (f, 0, SEEK_END)) {
+		n = ftell (f);
+	}
+	if (f) {
+		fclose (f);
+	}
+	return n;
+}
+
+int
+main (int argc, char** argv)
+{
+	static const char* fmt_name[] = { "raw", "compact" };
+
+	uint32_t n_cycles = argc > 1 ? atoi (argv[1]) : 100000;
+	FILE*    json     = NULL;
+
+	if (n_cycles < 1) {
+		fprintf (stderr, "Usage: capture_bench [n_cycles] [results.json]\n");
+		return 1;
+	}
+	if (argc > 2 && !(json = fopen (argv[2], "w"))) {
+		perror (argv[2]);
+		return 1;
+	}
+
+	LV2_URID_Map map = { NULL, map_uri };
+	Session      s;
+	lv2_atom_forge_init (&s.forge, &map);
+	s.patch_Set      = map_uri (NULL, LV2_PATCH__Set);
+	s.patch_property = map_uri (NULL, LV2_PATCH__property);
+	s.patch_value    = map_uri (NULL, LV2_PATCH__value);
+	s.time_Position  = map_uri (NULL, LV2_TIME__Position);
+	s.time_frame     = map_uri (NULL, LV2_TIME__frame);
+	s.time_speed     = map_uri (NULL, LV2_TIME__speed);
+	s.time_bar       = map_uri (NULL, LV2_TIME__bar);
+	s.time_barBeat   = map_uri (NULL, LV2_TIME__barBeat);
+	s.param[0]       = map_uri (NULL, REQVAL_URI "#gain");
+	s.param[1]       = map_uri (NULL, REQVAL_URI "#lookahead");
+	s.param[2]       = map_uri (NULL, REQVAL_URI "#booltest");
+
+	const LV2_URID atom_Object = map_uri (NULL, LV2_ATOM__Object);
+	const LV2_URID atom_URID   = map_uri (NULL, LV2_ATOM__URID);
+
+	Input in;
+	memset (&in, 0, sizeof (in));
+	in.n_cycles  = n_cycles;
+	in.data      = (uint8_t*)calloc (n_cycles, CYCLE_BUFSIZ);
+	in.n_samples = (uint32_t*)calloc (n_cycles, sizeof (uint32_t));
+	if (!in.data || !in.n_samples) {
+		fprintf (stderr, "Out of memory\n");
+		return 1;
+	}
+	generate (&s, &in);
+
+	uint64_t input_size = 0;
+	for (uint32_t i = 0; i < n_cycles; ++i) {
+		input_size += input_cycle (&in, i)->atom.size;
+	}
+
+	const char* dir = getenv ("TMPDIR");
+	char        path[2][1024];
+	long        size[2];
+	uint64_t    t_enc[2], t_dec[2], t_verify;
+	int         rv = 0;
+
+	printf ("%u cycles, %lu events, %lu bytes of sequences\n", n_cycles, (unsigned long)in.n_events, (unsigned long)input_size);
+
+	for (int f = CAP_RAW; f <= CAP_COMPACT; ++f) {
+		snprintf (path[f], sizeof (path[f]), "%s/reqval-capture-%d.%s", dir ? dir : "/tmp", (int)getpid (), fmt_name[f]);
+
+		if (!encode (&in, path[f], (CaptureFormat)f, atom_Object, atom_URID, &t_enc[f])
+		    || !decode (&in, path[f], true, &t_verify)) {
+			rv = 1;
+		}
+		for (int k = 0; k < DECODE_RUNS && rv == 0; ++k) {
+			uint64_t t;
+			if (!decode (&in, path[f], false, &t)) {
+				rv = 1;
+			} else if (k == 0 || t < t_dec[f]) {
+				t_dec[f] = t;
+			}
+		}
+		size[f] = file_size (path[f]);
+		unlink (path[f]);
+
+		printf ("%-8s %10ld bytes %6.2f bytes/event  encode %6.2f ns/event  decode %6.2f ns/event\n",
+		        fmt_name[f], size[f], size[f] / (double)in.n_events,
+		        t_enc[f] / (double)in.n_events, t_dec[f] / (double)in.n_events);
+	}
+
+	printf ("compact: %.1f%% of raw, decoding takes %.2fx the time of raw\n",
+	        100. * size[CAP_COMPACT] / size[CAP_RAW], t_dec[CAP_COMPACT] / (double)t_dec[CAP_RAW]);
+
+	if (json) {
+		fprintf (json, "{\n  \"benchmark\": \"capture_bench\",\n  \"cycles\": %u,\n  \"events\": %lu,\n  \"metrics\": {\n", n_cycles, (unsigned long)in.n_events);
+		for (int f = CAP_RAW; f <= CAP_COMPACT; ++f) {
+			fprintf (json, "    \"%s_bytes_per_event\": %.3f,\n", fmt_name[f], size[f] / (double)in.n_events);
+			fprintf (json, "    \"%s_encode_ns_per_event\": %.3f,\n", fmt_name[f], t_enc[f] / (double)in.n_events);
+			fprintf (json, "    \"%s_decode_ns_per_event\": %.3f,\n", fmt_name[f], t_dec[f] / (double)in.n_events);
+		}
+		fprintf (json, "    \"failed\": %d\n  }\n}\n", rv);
+		fclose (json);
+	}
+
+	free (in.data);
+	free (in.n_samples);
+	for (uint32_t i = 0; i < n_urids; ++i) {
+		free (urids[i]);
+	}
+	return rv;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Accuracy and throughput of src/dbtable.h compared to libm
+ *
+ *   make bench
+ *   ./build/db_bench [n_conversions] [results.json]
+ *
+ * Exits with an error if the tables exceed the documented error.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/dbtable.h"
+
+#define MAX_REL_ERR 5e-5 // dB to gain
+#define MAX_DB_ERR 5e-5  // gain to dB
+
+typedef float (*ConvFn) (DbTable const*, float);
+
+static inline uint64_t
+now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static float
+libm_to_gain (DbTable const* t, float db)
+{
+	return powf (10.f, .05f * db);
+}
+
+static float
+libm_to_db (DbTable const* t, float gain)
+{
+	return 20.f * log10f (gain);
+}
+
+/* ns per conversion, inputs are precomputed to time only the conversion */
+static double
+throughput (ConvFn fn, DbTable const* t, float const* in, uint32_t n_in, uint32_t n)
+{
+	volatile float sink = 0;
+	float          sum  = 0;
+
+	const uint64_t t0 = now_ns ();
+	for (uint32_t i = 0; i < n; ++i) {
+		sum += fn (t, in[i % n_in]);
+	}
+	const uint64_t t1 = now_ns ();
+
+	sink = sum;
+	(void)sink;
+	return (t1 - t0) / (double)n;
+}
+
+int
+main (int argc, char** argv)
+{
+	uint32_t n    = argc > 1 ? atoi (argv[1]) : 10000000;
+	FILE*    json = NULL;
+	DbTable  t;
+
+	if (argc > 2 && !(json = fopen (argv[2], "w"))) {
+		perror (argv[2]);
+		return 1;
+	}
+
+	const uint64_t t0 = now_ns ();
+	dbt_init (&t);
+	const uint64_t t1 = now_ns ();
+
+	/* accuracy over the table range, against double precision */
+	double max_rel = 0, max_db = 0;
+	for (int i = 0; i <= (DBTABLE_MAX - DBTABLE_MIN) * 1000; ++i) {
+		const float  db  = DBTABLE_MIN + i / 1000.f;
+		const double ref = pow (10.0, .05 * db);
+		const double err = fabs (dbt_to_gain (&t, db) - ref) / ref;
+		if (err > max_rel) {
+			max_rel = err;
+		}
+	}
+	for (int i = 0; i <= 200000; ++i) {
+		const float  gain = powf (10.f, -6.f + i * 7.f / 200000.f); // -120..+20 dB
+		const double err  = fabs (dbt_to_db (&t, gain) - 20.0 * log10 ((double)gain));
+		if (err > max_db) {
+			max_db = err;
+		}
+	}
+
+	/* random inputs within the table range */
+	enum { N_IN = 4096 };
+	static float in_db[N_IN], in_gain[N_IN];
+	srand (1);
+	for (int i = 0; i < N_IN; ++i) {
+		in_db[i]   = DBTABLE_MIN + (DBTABLE_MAX - DBTABLE_MIN) * (rand () / (float)RAND_MAX);
+		in_gain[i] = powf (10.f, .05f * in_db[i]);
+	}
+
+	const double ns_powf = throughput (libm_to_gain, &t, in_db, N_IN, n);
+	const double ns_gain = throughput (dbt_to_gain, &t, in_db, N_IN, n);
+	const double ns_log  = throughput (libm_to_db, &t, in_gain, N_IN, n);
+	const double ns_db   = throughput (dbt_to_db, &t, in_gain, N_IN, n);
+
+	printf ("dbt_init:    %8.2f us, %u bytes\n", (t1 - t0) / 1e3, (unsigned)sizeof (DbTable));
+	printf ("dB to gain:  max rel. error %.2e  powf %6.2f ns  table %6.2f ns  (%.1fx)\n", max_rel, ns_powf, ns_gain, ns_powf / ns_gain);
+	printf ("gain to dB:  max abs. error %.2e dB  log10f %6.2f ns  table %6.2f ns  (%.1fx)\n", max_db, ns_log, ns_db, ns_log / ns_db);
+
+	if (json) {
+		fprintf (json, "{\n  \"benchmark\": \"db_bench\",\n  \"conversions\": %u,\n  \"metrics\": {\n", n);
+		fprintf (json, "    \"db_to_gain_ns\": %.3f,\n", ns_gain);
+		fprintf (json, "    \"db_to_gain_max_rel_err\": %.3e,\n", max_rel);
+		fprintf (json, "    \"gain_to_db_ns\": %.3f,\n", ns_db);
+		fprintf (json, "    \"gain_to_db_max_err\": %.3e\n", max_db);
+		fprintf (json, "  }\n}\n");
+		fclose (json);
+	}
+
+	if (max_rel > MAX_REL_ERR || max_db > MAX_DB_ERR) {
+		fprintf (stderr, "Error exceeds the limit (%.0e, %.0e dB)\n", MAX_REL_ERR, MAX_DB_ERR);
+		return 1;
+	}
+	return 0;
+}
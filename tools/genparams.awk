@@ -0,0 +1,177 @@
+#!/usr/bin/awk -f
+#
+# generate parameter definitions from src/parameters.spec
+#
+#   awk -F'|' -v mode=header -f tools/genparams.awk src/parameters.spec > parameters.h
+#   awk -F'|' -v mode=ttl    -f tools/genparams.awk src/parameters.spec > parameters.ttl
+#
+# For the .ttl the plugin URI is passed with -v plugin=<URI>
+
+function ctype(t) {
+	if (t == "Bool")  return "bool";
+	if (t == "Int")   return "int32_t";
+	if (t == "Float") return "float";
+	return "";
+}
+
+function kind(t) {
+	if (t == "Bool")  return "RVC_BOOL";
+	if (t == "Int")   return "RVC_INT";
+	if (t == "Float") return "RVC_FLOAT";
+	if (t == "Path")  return "RVC_PATH";
+	printf ("genparams: unknown type '%s' on line %d\n", t, NR) > "/dev/stderr";
+	err = 1;
+	exit 1;
+}
+
+function num(v, d) {
+	return v == "" ? d : v;
+}
+
+# enumeration "value:label,value:label" -> ev[], el[], returns count
+function parse_enum(str,    items, kv, k, cnt) {
+	delete ev;
+	delete el;
+	if (str == "") {
+		return 0;
+	}
+	cnt = split (str, items, ",");
+	for (k = 1; k <= cnt; ++k) {
+		split (items[k], kv, ":");
+		ev[k] = kv[1];
+		el[k] = kv[2];
+	}
+	return cnt;
+}
+
+# answer cache policy -> seconds or REQVAL_CACHE_*
+function cache(c, t) {
+	if (c == "")        return "0";
+	if (ctype(t) == "") {
+		printf ("genparams: %s values cannot be cached, line %d\n", t, NR) > "/dev/stderr";
+		err = 1;
+		exit 1;
+	}
+	if (c == "session") return "REQVAL_CACHE_SESSION";
+	if (c == "forever") return "REQVAL_CACHE_FOREVER";
+	if (c ~ /^[0-9]+$/) return c;
+	printf ("genparams: invalid cache policy '%s' on line %d\n", c, NR) > "/dev/stderr";
+	err = 1;
+	exit 1;
+}
+
+BEGIN { n = 0; err = 0; }
+
+/^[ \t]*#/ || /^[ \t]*$/ { next; }
+
+{
+	if (NF < 7 || NF > 9) {
+		printf ("genparams: expected 7 to 9 fields on line %d\n", NR) > "/dev/stderr";
+		err = 1;
+		exit 1;
+	}
+	sym[n] = $1; type[n] = $2; min[n] = $3; max[n] = $4; def[n] = $5; label[n] = $6; comment[n] = $7;
+	enm[n] = NF > 7 ? $8 : "";
+	kind(type[n]);
+	ttl[n] = cache(NF > 8 ? $9 : "", type[n]);
+	++n;
+}
+
+END {
+	if (err) {
+		exit 1;
+	}
+
+	if (mode == "ttl") {
+		for (i = 0; i < n; ++i) {
+			printf ("\nreqval:%s\n\ta lv2:Parameter ;\n", sym[i]);
+			printf ("\trdfs:label \"%s\" ;\n", label[i]);
+			printf ("\trdfs:comment \"%s\" ;\n", comment[i]);
+			if (min[i] != "") printf ("\tlv2:minimum %s ;\n", min[i]);
+			if (max[i] != "") printf ("\tlv2:maximum %s ;\n", max[i]);
+			if (def[i] != "") printf ("\tlv2:default %s ;\n", def[i]);
+			ne = parse_enum(enm[i]);
+			if (ne > 0) {
+				printf ("\tlv2:portProperty lv2:enumeration ;\n");
+				for (k = 1; k <= ne; ++k) {
+					printf ("\tlv2:scalePoint [ rdfs:label \"%s\" ; rdf:value %s ] ;\n", el[k], ev[k]);
+				}
+			}
+			printf ("\trdfs:range atom:%s .\n", type[i]);
+		}
+		printf ("\n");
+		for (i = 0; i < n; ++i) {
+			printf ("<%s> patch:writable reqval:%s .\n", plugin, sym[i]);
+		}
+		exit 0;
+	}
+
+	printf ("/* generated by tools/genparams.awk from src/parameters.spec -- do not edit */\n\n");
+	printf ("#ifndef REQVAL_PARAMETERS_H\n#define REQVAL_PARAMETERS_H\n\n");
+	printf ("#include \"uris.h\"\n\n");
+
+	for (i = 0; i < n; ++i) {
+		printf ("#define REQVAL__%s REQVAL_URI \"#%s\"\n", sym[i], sym[i]);
+	}
+
+	printf ("\nenum {\n");
+	for (i = 0; i < n; ++i) {
+		printf ("\tREQVAL_P_%s,\n", sym[i]);
+	}
+	printf ("\tREQVAL_N_PARAMS\n};\n\n");
+
+	printf ("/* define REQVAL_NO_PARAM_TABLE for URIs and indices only (e.g. UI) */\n");
+	printf ("#ifndef REQVAL_NO_PARAM_TABLE\n\n");
+	printf ("#include <float.h>\n#include <stddef.h>\n#include <stdint.h>\n\n");
+	printf ("#include \"reqval_client.h\"\n\n");
+
+	printf ("typedef struct {\n");
+	stored = 0;
+	for (i = 0; i < n; ++i) {
+		if (ctype(type[i]) != "") {
+			printf ("\t%s %s;\n", ctype(type[i]), sym[i]);
+			++stored;
+		}
+	}
+	if (!stored) {
+		printf ("\tchar _unused;\n");
+	}
+	printf ("} ReqValParamValues;\n\n");
+
+	printf ("static const ReqValParamValues reqval_param_defaults = {\n");
+	for (i = 0; i < n; ++i) {
+		if (ctype(type[i]) != "") {
+			printf ("\t.%s = %s,\n", sym[i], num(def[i], 0));
+		}
+	}
+	printf ("};\n\n");
+
+	for (i = 0; i < n; ++i) {
+		ne = parse_enum(enm[i]);
+		if (ne > 0) {
+			printf ("static const float reqval_enum_%s[%d] = { ", sym[i], ne);
+			for (k = 1; k <= ne; ++k) {
+				printf ("%s%s", ev[k], k < ne ? ", " : " };\n");
+			}
+		}
+	}
+	printf ("\n");
+
+	printf ("static const RVC_ParamSpec reqval_params[REQVAL_N_PARAMS] = {\n");
+	for (i = 0; i < n; ++i) {
+		off = ctype(type[i]) != "" ? sprintf ("offsetof (ReqValParamValues, %s)", sym[i]) : "-1";
+		ne  = parse_enum(enm[i]);
+		enl = ne > 0 ? sprintf ("reqval_enum_%s, %d", sym[i], ne) : "NULL, 0";
+		printf ("\t{ REQVAL__%s, %s, %s, %s, %s, %s, %s },\n", sym[i], kind(type[i]), num(min[i], "-FLT_MAX"), num(max[i], "FLT_MAX"), num(def[i], 0), off, enl);
+	}
+	printf ("};\n\n");
+
+	printf ("/* answer cache policy, time to live in seconds, 0: not cached */\n");
+	printf ("#define REQVAL_CACHE_SESSION -1 /* not saved with the session */\n");
+	printf ("#define REQVAL_CACHE_FOREVER -2\n\n");
+	printf ("static const int32_t reqval_cache_ttl[REQVAL_N_PARAMS] = {\n");
+	for (i = 0; i < n; ++i) {
+		printf ("\t%s, /* %s */\n", ttl[i], sym[i]);
+	}
+	printf ("};\n\n#endif\n#endif\n");
+}
@@ -0,0 +1,80 @@
+#!/usr/bin/awk -f
+#
+# compare benchmark results against a baseline
+#
+#   awk -f tools/perf_check.awk tools/perf-tolerances baseline.json current.json
+#
+# JSON files are as written by `bench_host -j`: flat, one metric per
+# line inside the "metrics" object, all metrics are "lower is better".
+#
+# The tolerance file lists the allowed regression per metric in percent,
+# "-" to ignore a metric. Metrics not listed use the "default" entry.
+# Exits with status 1 if any metric regressed beyond its tolerance.
+
+BEGIN { file = 0; tol_default = 10; failed = 0; n = 0; }
+
+FNR == 1 { ++file; in_metrics = 0; }
+
+# tolerances
+file == 1 {
+	if ($0 ~ /^[ \t]*#/ || NF < 2) {
+		next;
+	}
+	if ($1 == "default") {
+		tol_default = $2;
+	} else {
+		tol[$1] = $2;
+	}
+	next;
+}
+
+/"metrics"[ \t]*:/ { in_metrics = 1; next; }
+in_metrics && /}/  { in_metrics = 0; next; }
+
+in_metrics {
+	line = $0;
+	gsub (/[",]/, "", line);
+	split (line, kv, ":");
+	key = kv[1];
+	gsub (/[ \t]/, "", key);
+	val = kv[2] + 0;
+	if (file == 2) {
+		base[key] = val;
+		order[n++] = key;
+	} else {
+		cur[key] = val;
+	}
+}
+
+END {
+	if (file < 3) {
+		printf ("perf_check: usage: perf_check.awk <tolerances> <baseline.json> <current.json>\n") > "/dev/stderr";
+		exit 2;
+	}
+
+	printf ("%-24s %14s %14s %9s %7s\n", "metric", "baseline", "current", "change", "limit");
+	for (i = 0; i < n; ++i) {
+		key = order[i];
+		t   = (key in tol) ? tol[key] : tol_default;
+
+		if (!(key in cur)) {
+			printf ("%-24s %14.2f %14s %9s %7s  MISSING\n", key, base[key], "-", "-", "-");
+			failed = 1;
+			continue;
+		}
+
+		delta = base[key] > 0 ? 100 * (cur[key] - base[key]) / base[key] : 0;
+
+		if (t == "-") {
+			status = "ignored";
+		} else if (delta > t) {
+			status = "REGRESSION";
+			failed = 1;
+		} else {
+			status = "ok";
+		}
+		printf ("%-24s %14.2f %14.2f %+8.1f%% %7s  %s\n", key, base[key], cur[key], delta, t == "-" ? "-" : t "%", status);
+	}
+
+	exit failed;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2021 Robin Gareus <robin@gareus.org>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Throughput and latency benchmark for src/ringbuffer.h
+ *
+ *   make bench
+ *   ./build/ring_bench [n_messages] [max_producers] [results.json]
+ *
+ * Each record carries a CLOCK_MONOTONIC timestamp taken by the producer,
+ * the consumer computes the transfer latency. Threads are pinned to
+ * separate cores where supported.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/ringbuffer.h"
+
+#define MAX_PRODUCERS 64
+#define HIST_BINS 4096 // latency histogram, 64ns bins
+
+typedef struct {
+	uint64_t ts;
+	uint32_t producer;
+	uint32_t seq;
+	uint8_t  payload[48];
+} Record;
+
+typedef struct {
+	SPSCRing* spsc;
+	MPSCRing* mpsc;
+	uint32_t  id;
+	uint32_t  n_msgs;
+	int       cpu;
+} Producer;
+
+static uint64_t hist[HIST_BINS];
+
+/* JSON output, metrics are "lower is better", see tools/perf_check.awk */
+static FILE*       json     = NULL;
+static const char* json_sep = "";
+
+static inline uint64_t
+now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+pin (int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO (&set);
+	CPU_SET (cpu, &set);
+	pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+#endif
+}
+
+/* vary the record size to exercise wrap-around of the SPSC ring */
+static inline uint32_t
+record_len (uint32_t seq)
+{
+	return 16 + (seq % 5) * 8;
+}
+
+static void*
+producer (void* arg)
+{
+	Producer* p = (Producer*)arg;
+	Record    r;
+	pin (p->cpu);
+	memset (&r, 0, sizeof (r));
+	r.producer = p->id;
+	for (uint32_t i = 0; i < p->n_msgs; ++i) {
+		r.seq = i;
+		for (;;) {
+			r.ts = now_ns ();
+			if (p->spsc ? spsc_write (p->spsc, &r, record_len (i)) : mpsc_write (p->mpsc, &r, record_len (i))) {
+				break;
+			}
+			sched_yield (); // full
+		}
+	}
+	return NULL;
+}
+
+static void
+consume (SPSCRing* spsc, MPSCRing* mpsc, uint32_t n_producers, uint32_t n_msgs)
+{
+	uint32_t expect[MAX_PRODUCERS] = { 0 };
+	uint64_t total                 = (uint64_t)n_producers * n_msgs;
+	Record   r;
+
+	while (total > 0) {
+		uint32_t len = spsc ? spsc_read (spsc, &r, sizeof (r)) : mpsc_read (mpsc, &r, sizeof (r));
+		if (len == 0) {
+			sched_yield (); // empty
+			continue;
+		}
+		uint64_t lat = (now_ns () - r.ts) >> 6;
+		++hist[lat < HIST_BINS ? lat : HIST_BINS - 1];
+
+		if (len != record_len (r.seq) || r.seq != expect[r.producer]) {
+			fprintf (stderr, "Ordering error: producer %u seq %u (expected %u) len %u\n", r.producer, r.seq, expect[r.producer], len);
+			exit (EXIT_FAILURE);
+		}
+		++expect[r.producer];
+		--total;
+	}
+}
+
+static double
+percentile (uint64_t total, double pct)
+{
+	uint64_t limit = total * pct;
+	uint64_t sum   = 0;
+	for (int i = 0; i < HIST_BINS; ++i) {
+		sum += hist[i];
+		if (sum > limit) {
+			return i * 64.0;
+		}
+	}
+	return HIST_BINS * 64.0;
+}
+
+static void
+run_bench (const char* name, uint32_t n_producers, uint32_t n_msgs, int n_cpus)
+{
+	SPSCRing* spsc = NULL;
+	MPSCRing* mpsc = NULL;
+	pthread_t threads[MAX_PRODUCERS];
+	Producer  prod[MAX_PRODUCERS];
+
+	if (n_producers == 0) {
+		spsc        = spsc_ring_new (8192);
+		n_producers = 1;
+	} else {
+		mpsc = mpsc_ring_new (128, sizeof (Record));
+	}
+
+	memset (hist, 0, sizeof (hist));
+	pin (0);
+
+	const uint64_t t0 = now_ns ();
+	for (uint32_t i = 0; i < n_producers; ++i) {
+		prod[i].spsc   = spsc;
+		prod[i].mpsc   = mpsc;
+		prod[i].id     = i;
+		prod[i].n_msgs = n_msgs;
+		prod[i].cpu    = n_cpus > 1 ? 1 + (i % (n_cpus - 1)) : 0; // consumer on CPU 0
+		pthread_create (&threads[i], NULL, producer, &prod[i]);
+	}
+
+	consume (spsc, mpsc, n_producers, n_msgs);
+
+	const uint64_t t1 = now_ns ();
+	for (uint32_t i = 0; i < n_producers; ++i) {
+		pthread_join (threads[i], NULL);
+	}
+
+	const uint64_t total = (uint64_t)n_producers * n_msgs;
+	printf ("%-6s %3u producer(s): %7.2f Mops/s  latency p50 %6.0fns  p99 %6.0fns  p99.9 %6.0fns\n",
+	        name, n_producers, total * 1e3 / (double)(t1 - t0),
+	        percentile (total, .5), percentile (total, .99), percentile (total, .999));
+
+	if (json) {
+		fprintf (json, "%s    \"%s_%up_ns_per_msg\": %.2f,\n", json_sep, name, n_producers, (t1 - t0) / (double)total);
+		fprintf (json, "    \"%s_%up_p50_ns\": %.0f,\n", name, n_producers, percentile (total, .5));
+		fprintf (json, "    \"%s_%up_p99_ns\": %.0f", name, n_producers, percentile (total, .99));
+		json_sep = ",\n";
+	}
+
+	spsc_ring_free (spsc);
+	mpsc_ring_free (mpsc);
+}
+
+int
+main (int argc, char** argv)
+{
+	uint32_t n_msgs        = argc > 1 ? atoi (argv[1]) : 1000000;
+	int      n_cpus        = sysconf (_SC_NPROCESSORS_ONLN);
+	uint32_t max_producers = argc > 2 ? atoi (argv[2]) : (n_cpus > 2 ? n_cpus - 1 : 2);
+
+	if (max_producers > MAX_PRODUCERS) {
+		max_producers = MAX_PRODUCERS;
+	}
+
+	printf ("%d CPUs, %u messages per producer\n", n_cpus, n_msgs);
+
+	if (argc > 3 && !(json = fopen (argv[3], "w"))) {
+		perror (argv[3]);
+		return 1;
+	}
+	if (json) {
+		fprintf (json, "{\n  \"benchmark\": \"ring_bench\",\n  \"cpus\": %d,\n  \"messages\": %u,\n  \"metrics\": {\n", n_cpus, n_msgs);
+	}
+
+	run_bench ("SPSC", 0, n_msgs, n_cpus);
+	for (uint32_t n = 1; n <= max_producers; n *= 2) {
+		run_bench ("MPSC", n, n_msgs, n_cpus);
+	}
+
+	if (json) {
+		fprintf (json, "\n  }\n}\n");
+		fclose (json);
+	}
+	return 0;
+}